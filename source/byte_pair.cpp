@@ -13,43 +13,363 @@
 //
 // Description:
 //
-
-#include <string.h>
+
+#include <string.h>
 #include <assert.h>
 #include "byte_pair.h"
+#include "cpufeatures.h"
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
 
-const TInt MaxBlockSize = 0x1000;
+BytePairContext::BytePairContext():
+	iIncremental(true), iVectorized(true), iStrategy(EPakTieBreakBytes), iDeviation(-1), iTouchedCount(0), iCandidateCount(0), iPairCountDirty(false)
+	{
+	memset(iPairCount,0,sizeof(iPairCount));
+	memset(iPairState,0,sizeof(iPairState));
+	memset(iTieCount,0,sizeof(iTieCount));
+	memset(iGlobalPairs,0,sizeof(iGlobalPairs));
+	memset(iGlobalTokenCounts,0,sizeof(iGlobalTokenCounts));
+	}
 
-TUint16 PairCount[0x10000];
-TUint16 PairBuffer[MaxBlockSize*2];
 
-TUint16 GlobalPairs[0x10000] = {0};
-TUint16 GlobalTokenCounts[0x100] = {0};
+/*
+Kernels for the hot loops of Pak(). The scalar versions are the reference, the
+SSE2 and AVX2 versions are selected at runtime and must give the same results.
+*/
+struct BytePairKernels
+	{
+	void (*iCountBytes)(TUint16* ByteCount, TUint8* data, TInt size);
+	TInt (*iLeastCommonByte)(TUint16* ByteCount, TInt& byte);
+	TUint8* (*iEscapeMarker)(TUint8* out, TUint8* in, TInt size, TInt marker);
+	TUint8* (*iFindSpecial)(TUint8* data, TUint8* end, TInt marker, TInt byte, TInt b1);
+	};
 
-TUint16 ByteCount[0x100+4];
 
-void CountBytes(TUint8* data, TInt size)
+static void CountBytesScalar(TUint16* ByteCount, TUint8* data, TInt size)
 	{
-	memset(ByteCount,0,sizeof(ByteCount));
 	TUint8* dataEnd = data+size;
 	while(data<dataEnd)
 		++ByteCount[*data++];
 	}
 
 
-inline void ByteUsed(TInt b)
+static TInt LeastCommonByteScalar(TUint16* ByteCount, TInt& byte)
 	{
-	ByteCount[b] = 0xffff;
+	TInt bestCount = 0xffff;
+	TInt bestByte = -1;
+	for(TInt b=0; b<0x100; b++)
+		{
+		TInt f = ByteCount[b];
+		if(f<bestCount)
+			{
+			bestCount = f;
+			bestByte = b;
+			}
+		}
+	byte = bestByte;
+	return bestCount;
+	}
+
+
+/**
+Copies data doubling every marker byte.
+@return end of output
+*/
+static TUint8* EscapeMarkerScalar(TUint8* out, TUint8* in, TInt size, TInt marker)
+	{
+	TUint8* inEnd = in+size;
+	while(in<inEnd)
+		{
+		TInt b=*in++;
+		if(b==marker)
+			*out++ = (TUint8)b;
+		*out++ = (TUint8)b;
+		}
+	return out;
+	}
+
+
+/**
+Finds first of bytes which SubstitutePair() can't copy as is.
+@return pointer to the byte or end
+*/
+static TUint8* FindSpecialScalar(TUint8* data, TUint8* end, TInt marker, TInt byte, TInt b1)
+	{
+	while(data<end)
+		{
+		TInt b = *data;
+		if(b==marker || b==byte || b==b1)
+			break;
+		++data;
+		}
+	return data;
+	}
+
+
+static const BytePairKernels KScalarKernels =
+	{
+	CountBytesScalar, LeastCommonByteScalar, EscapeMarkerScalar, FindSpecialScalar
+	};
+
+
+#if defined(CPU_X86)
+
+inline TInt FirstSetBit(TUint32 mask)
+	{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i,mask);
+	return (TInt)i;
+#else
+	return __builtin_ctz(mask);
+#endif
+	}
+
+
+/**
+Counts 16 bytes per step into four tables, so the increments of successive
+bytes don't wait for each other, and sums the tables at the end.
+*/
+TARGET_SSE2 static void CountBytesSSE2(TUint16* ByteCount, TUint8* data, TInt size)
+	{
+	TUint16 counts[4][0x100];
+	memset(counts,0,sizeof(counts));
+	TUint8* dataEnd = data+size;
+	while(dataEnd-data>=16)
+		{
+		__m128i v = _mm_loadu_si128((const __m128i*)data);
+		for(TInt i=0; i<4; i++)
+			{
+			TUint32 w = (TUint32)_mm_cvtsi128_si32(v);
+			++counts[0][w&0xff];
+			++counts[1][(w>>8)&0xff];
+			++counts[2][(w>>16)&0xff];
+			++counts[3][w>>24];
+			v = _mm_srli_si128(v,4);
+			}
+		data += 16;
+		}
+	while(data<dataEnd)
+		++counts[0][*data++];
+
+	for(TInt b=0; b<0x100; b+=8)
+		{
+		__m128i c = _mm_loadu_si128((const __m128i*)(ByteCount+b));
+		c = _mm_add_epi16(c,_mm_loadu_si128((const __m128i*)(counts[0]+b)));
+		c = _mm_add_epi16(c,_mm_loadu_si128((const __m128i*)(counts[1]+b)));
+		c = _mm_add_epi16(c,_mm_loadu_si128((const __m128i*)(counts[2]+b)));
+		c = _mm_add_epi16(c,_mm_loadu_si128((const __m128i*)(counts[3]+b)));
+		_mm_storeu_si128((__m128i*)(ByteCount+b),c);
+		}
+	}
+
+
+/**
+Finds minimum of the table, then the first byte with such count.
+SSE2 has only signed 16-bit minimum, so the counts are biased by 0x8000.
+*/
+TARGET_SSE2 static TInt LeastCommonByteSSE2(TUint16* ByteCount, TInt& byte)
+	{
+	const __m128i bias = _mm_set1_epi16((short)0x8000);
+	__m128i m = _mm_set1_epi16(0x7fff);
+	for(TInt b=0; b<0x100; b+=8)
+		m = _mm_min_epi16(m,_mm_xor_si128(_mm_loadu_si128((const __m128i*)(ByteCount+b)),bias));
+	m = _mm_min_epi16(m,_mm_srli_si128(m,8));
+	m = _mm_min_epi16(m,_mm_srli_si128(m,4));
+	m = _mm_min_epi16(m,_mm_srli_si128(m,2));
+	TInt bestCount = (_mm_cvtsi128_si32(m)&0xffff)^0x8000;
+	if(bestCount==0xffff)
+		{
+		byte = -1;
+		return bestCount;
+		}
+	m = _mm_xor_si128(_mm_shufflelo_epi16(m,0),bias);
+	m = _mm_unpacklo_epi64(m,m);
+	for(TInt b=0; ; b+=8)
+		{
+		TUint32 mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(ByteCount+b)),m));
+		if(mask)
+			{
+			byte = b+FirstSetBit(mask)/2;
+			return bestCount;
+			}
+		}
+	}
+
+
+TARGET_AVX2 static TInt LeastCommonByteAVX2(TUint16* ByteCount, TInt& byte)
+	{
+	__m256i m = _mm256_set1_epi16(-1);
+	for(TInt b=0; b<0x100; b+=16)
+		m = _mm256_min_epu16(m,_mm256_loadu_si256((const __m256i*)(ByteCount+b)));
+	__m128i h = _mm_min_epu16(_mm256_castsi256_si128(m),_mm256_extracti128_si256(m,1));
+	h = _mm_minpos_epu16(h);
+	TInt bestCount = _mm_cvtsi128_si32(h)&0xffff;
+	if(bestCount==0xffff)
+		{
+		byte = -1;
+		return bestCount;
+		}
+	m = _mm256_set1_epi16((short)bestCount);
+	for(TInt b=0; ; b+=16)
+		{
+		TUint32 mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(ByteCount+b)),m));
+		if(mask)
+			{
+			byte = b+FirstSetBit(mask)/2;
+			return bestCount;
+			}
+		}
+	}
+
+
+/**
+Copies whole vectors which have no marker, output never gets shorter than input
+so stores stay inside the final output.
+*/
+TARGET_SSE2 static TUint8* EscapeMarkerSSE2(TUint8* out, TUint8* in, TInt size, TInt marker)
+	{
+	TUint8* inEnd = in+size;
+	const __m128i m = _mm_set1_epi8((char)marker);
+	while(inEnd-in>=16)
+		{
+		__m128i v = _mm_loadu_si128((const __m128i*)in);
+		_mm_storeu_si128((__m128i*)out,v);
+		TUint32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v,m));
+		if(!mask)
+			{
+			in += 16;
+			out += 16;
+			continue;
+			}
+		// the bytes up to the first marker are in place, double the marker
+		TInt n = FirstSetBit(mask)+1;
+		in += n;
+		out += n;
+		*out++ = (TUint8)marker;
+		}
+	return EscapeMarkerScalar(out,in,inEnd-in,marker);
+	}
+
+
+TARGET_AVX2 static TUint8* EscapeMarkerAVX2(TUint8* out, TUint8* in, TInt size, TInt marker)
+	{
+	TUint8* inEnd = in+size;
+	const __m256i m = _mm256_set1_epi8((char)marker);
+	while(inEnd-in>=32)
+		{
+		__m256i v = _mm256_loadu_si256((const __m256i*)in);
+		_mm256_storeu_si256((__m256i*)out,v);
+		TUint32 mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v,m));
+		if(!mask)
+			{
+			in += 32;
+			out += 32;
+			continue;
+			}
+		TInt n = FirstSetBit(mask)+1;
+		in += n;
+		out += n;
+		*out++ = (TUint8)marker;
+		}
+	return EscapeMarkerSSE2(out,in,inEnd-in,marker);
+	}
+
+
+TARGET_SSE2 static TUint8* FindSpecialSSE2(TUint8* data, TUint8* end, TInt marker, TInt byte, TInt b1)
+	{
+	const __m128i m = _mm_set1_epi8((char)marker);
+	const __m128i b = _mm_set1_epi8((char)byte);
+	const __m128i p = _mm_set1_epi8((char)b1);
+	while(end-data>=16)
+		{
+		__m128i v = _mm_loadu_si128((const __m128i*)data);
+		__m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v,m),_mm_cmpeq_epi8(v,b)),_mm_cmpeq_epi8(v,p));
+		TUint32 mask = _mm_movemask_epi8(hit);
+		if(mask)
+			return data+FirstSetBit(mask);
+		data += 16;
+		}
+	return FindSpecialScalar(data,end,marker,byte,b1);
+	}
+
+
+TARGET_AVX2 static TUint8* FindSpecialAVX2(TUint8* data, TUint8* end, TInt marker, TInt byte, TInt b1)
+	{
+	const __m256i m = _mm256_set1_epi8((char)marker);
+	const __m256i b = _mm256_set1_epi8((char)byte);
+	const __m256i p = _mm256_set1_epi8((char)b1);
+	while(end-data>=32)
+		{
+		__m256i v = _mm256_loadu_si256((const __m256i*)data);
+		__m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v,m),_mm256_cmpeq_epi8(v,b)),_mm256_cmpeq_epi8(v,p));
+		TUint32 mask = _mm256_movemask_epi8(hit);
+		if(mask)
+			return data+FirstSetBit(mask);
+		data += 32;
+		}
+	return FindSpecialSSE2(data,end,marker,byte,b1);
+	}
+
+
+static const BytePairKernels KSSE2Kernels =
+	{
+	CountBytesSSE2, LeastCommonByteSSE2, EscapeMarkerSSE2, FindSpecialSSE2
+	};
+
+static const BytePairKernels KAVX2Kernels =
+	{
+	CountBytesSSE2, LeastCommonByteAVX2, EscapeMarkerAVX2, FindSpecialAVX2
+	};
+
+#endif // CPU_X86
+
+
+static const BytePairKernels& SelectKernels()
+	{
+#if defined(CPU_X86)
+	const CpuFeatures& cpu = CpuFeatures::Get();
+	if(cpu.iAVX2)
+		return KAVX2Kernels;
+	if(cpu.iSSE2)
+		return KSSE2Kernels;
+#endif
+	return KScalarKernels;
+	}
+
+
+inline const BytePairKernels& Kernels(const BytePairContext& aCtx)
+	{
+	static const BytePairKernels& vector = SelectKernels();
+	return aCtx.iVectorized ? vector : KScalarKernels;
+	}
+
+
+static void CountBytes(BytePairContext& aCtx, TUint8* data, TInt size)
+	{
+	TUint16* ByteCount = aCtx.iByteCount;
+	memset(ByteCount,0,sizeof(aCtx.iByteCount));
+	Kernels(aCtx).iCountBytes(ByteCount,data,size);
+	}
+
+
+inline void ByteUsed(BytePairContext& aCtx, TInt b)
+	{
+	aCtx.iByteCount[b] = 0xffff;
 	}
 
 
 // 11915620
 // 11913551  	return -ByteCount[b1]-ByteCount[b2];
 // 11913185
+// Neither heuristic wins on every page, so EPakTieBreakPairs keeps the sum of
+// counts of overlapping pairs for the compression level which tries both.
 
-#if 0
-int TieBreak(int b1,int b2)
+static int PairTieBreak(BytePairContext& aCtx, int b1,int b2)
 	{
+	TUint16* PairCount = aCtx.iPairCount;
 	int i;
 	int x = 0;
 	for(i=0; i<0x100; i++)
@@ -59,16 +379,20 @@ int TieBreak(int b1,int b2)
 		y += PairCount[i];
 	return -x-y;
 	}
-#endif
 
-int TieBreak(int b1,int b2)
+inline int TieBreak(BytePairContext& aCtx, int b1,int b2)
 	{
-	return -ByteCount[b1]-ByteCount[b2];
+	if(aCtx.iStrategy==EPakTieBreakPairs)
+		return PairTieBreak(aCtx,b1,b2);
+	return -aCtx.iByteCount[b1]-aCtx.iByteCount[b2];
 	}
 
-TInt MostCommonPair(TInt& pair, TUint8* data, TInt size, TInt minFrequency, TInt marker)
+static TInt MostCommonPair(BytePairContext& aCtx, TInt& pair, TUint8* data, TInt size, TInt minFrequency, TInt marker, TInt exclude)
 	{
-	memset(PairCount,0,sizeof(PairCount));
+	TUint16* PairCount = aCtx.iPairCount;
+	TUint16* PairBuffer = aCtx.iPairBuffer;
+	memset(PairCount,0,sizeof(aCtx.iPairCount));
+	aCtx.iPairCountDirty = true;
 	TUint8* dataEnd = data+size-1;
 	TInt pairsFound = 0;
 	TInt lastPair = -1;
@@ -103,6 +427,7 @@ TInt MostCommonPair(TInt& pair, TUint8* data, TInt size, TInt minFrequency, TInt
 			PairBuffer[pairsFound++] = (TUint16)p;
 		}
 
+	const bool firstTie = aCtx.iStrategy==EPakTieBreakFirst;
 	TInt bestCount = -1;
 	TInt bestPair = -1;
 	TInt bestTieBreak = 0;
@@ -110,17 +435,19 @@ TInt MostCommonPair(TInt& pair, TUint8* data, TInt size, TInt minFrequency, TInt
 	while(pairsFound--)
 		{
 		p = PairBuffer[pairsFound];
+		if(p==exclude)
+			continue;
 		TInt f=PairCount[p];
 		if(f>bestCount)
 			{
 			bestCount = f;
 			bestPair = p;
-			bestTieBreak = TieBreak(p&0xff,p>>8);
+			bestTieBreak = TieBreak(aCtx,p&0xff,p>>8);
 			}
 		else if(f==bestCount)
 			{
-			TInt tieBreak = TieBreak(p&0xff,p>>8);
-			if(tieBreak>bestTieBreak)
+			TInt tieBreak = TieBreak(aCtx,p&0xff,p>>8);
+			if(tieBreak>bestTieBreak || (firstTie && tieBreak==bestTieBreak))
 				{
 				bestCount = f;
 				bestPair = p;
@@ -133,25 +460,357 @@ TInt MostCommonPair(TInt& pair, TUint8* data, TInt size, TInt minFrequency, TInt
 	}
 
 
-TInt LeastCommonByte(TInt& byte)
+/*
+Incremental pair counting.
+
+The counts MostCommonPair() computes are a sum of contributions of separate
+stretches of data. A scan may start afresh (lastPair = -1) at any unit boundary
+(a plain byte or a marker escape) which is a sync point: an escape, the first
+unit of data, or a plain byte that differs from a preceding plain byte. At such
+point the skipped pair can't be the same as the previous one, so the scan state
+doesn't matter.
+
+When a pair gets substituted only the bytes between two sync points around the
+change differ between old and new data. Such window is counted with negative
+sign over old data and with positive sign over new data, the rest of the page
+keeps its counts. Counts of every pair used during the page are cleared through
+iTouchedPairs instead of the whole table, and pairs seen at least
+KMinCandidateCount times are kept in iCandidates for MostCommonPair lookups.
+*/
+
+const TUint8 KPairTouched = 1;
+const TUint8 KPairCandidate = 2;
+
+// the smallest minFrequency Pak() asks for: overhead is never below 2
+const TInt KMinCandidateCount = 3;
+
+inline void AddPair(BytePairContext& aCtx, TInt p)
 	{
-	TInt bestCount = 0xffff;
-	TInt bestByte = -1;
-	for(TInt b=0; b<0x100; b++)
+	TUint8& state = aCtx.iPairState[p];
+	if(!(state&KPairTouched))
 		{
-		TInt f = ByteCount[b];
-		if(f<bestCount)
+		state |= KPairTouched;
+		aCtx.iTouchedPairs[aCtx.iTouchedCount++] = (TUint16)p;
+		}
+	if(++aCtx.iPairCount[p]==KMinCandidateCount && !(state&KPairCandidate))
+		{
+		state |= KPairCandidate;
+		aCtx.iCandidates[aCtx.iCandidateCount++] = (TUint16)p;
+		}
+	}
+
+
+/**
+Counts pairs starting in range [start, end) of data the same way MostCommonPair() does.
+@param start - sync point to start scan
+@param end - sync point or size of data
+@param add - add the pairs to counters if true, remove them otherwise
+*/
+static void CountPairs(BytePairContext& aCtx, TUint8* data, TInt start, TInt end, TInt size, TInt marker, bool add)
+	{
+	if(end>size-1)
+		end = size-1;
+	TUint8* dataEnd = data+end;
+	data += start;
+	TInt lastPair = -1;
+	while(data<dataEnd)
+		{
+		TInt b1 = *data++;
+		if(b1==marker)
+			{
+			lastPair = -1;
+			++data;
+			continue;
+			}
+		TInt b2 = *data;
+		if(b2==marker)
+			{
+			lastPair = -1;
+			data+=2;
+			continue;
+			}
+		TInt p = (b2<<8)|b1;
+		if(p==lastPair)
+			{
+			lastPair = -1;
+			continue;
+			}
+		lastPair = p;
+		if(add)
+			AddPair(aCtx,p);
+		else
+			--aCtx.iPairCount[p];
+		}
+	}
+
+
+/**
+Finds the pair MostCommonPair() would return when several pairs have equal
+frequency and tie break. MostCommonPair() prefers the pair which reached
+minFrequency last while scanning (first with EPakTieBreakFirst), so scan data
+counting only the tied pairs.
+*/
+static TInt ResolveTie(BytePairContext& aCtx, TUint8* data, TInt size, TInt minFrequency, TInt marker,
+			TInt bestCount, TInt bestTieBreak, TInt exclude)
+	{
+	TUint16* TieCount = aCtx.iTieCount;
+	TUint16* ties = aCtx.iPairBuffer;
+	TInt tieCount = 0;
+	for(TInt i=0; i<aCtx.iCandidateCount; i++)
+		{
+		TInt p = aCtx.iCandidates[i];
+		if(p!=exclude && aCtx.iPairCount[p]==bestCount && TieBreak(aCtx,p&0xff,p>>8)==bestTieBreak)
+			{
+			ties[tieCount++] = (TUint16)p;
+			TieCount[p] = 1;
+			}
+		}
+
+	TInt remaining = tieCount;
+	TInt bestPair = -1;
+	TUint8* dataEnd = data+size-1;
+	TInt lastPair = -1;
+	while(data<dataEnd)
+		{
+		TInt b1 = *data++;
+		if(b1==marker)
+			{
+			lastPair = -1;
+			++data;
+			continue;
+			}
+		TInt b2 = *data;
+		if(b2==marker)
+			{
+			lastPair = -1;
+			data+=2;
+			continue;
+			}
+		TInt p = (b2<<8)|b1;
+		if(p==lastPair)
+			{
+			lastPair = -1;
+			continue;
+			}
+		lastPair = p;
+		if(TieCount[p] && ++TieCount[p]==minFrequency+1)
+			{
+			bestPair = p;
+			if(!--remaining || aCtx.iStrategy==EPakTieBreakFirst)
+				break;
+			}
+		}
+
+	while(tieCount--)
+		TieCount[ties[tieCount]] = 0;
+	assert(bestPair>=0);
+	return bestPair;
+	}
+
+
+/**
+Incremental counterpart of MostCommonPair(), picks the same pair from iCandidates.
+*/
+static TInt MostCommonCandidate(BytePairContext& aCtx, TInt& pair, TUint8* data, TInt size, TInt minFrequency, TInt marker, TInt exclude)
+	{
+	TUint16* candidates = aCtx.iCandidates;
+	TInt count = aCtx.iCandidateCount;
+	TInt bestCount = -1;
+	TInt bestPair = -1;
+	TInt bestTieBreak = 0;
+	TInt ties = 0;
+	TInt i = 0;
+	while(i<count)
+		{
+		TInt p = candidates[i];
+		TInt f = aCtx.iPairCount[p];
+		if(f<KMinCandidateCount)
+			{
+			// drop pairs which became rare
+			aCtx.iPairState[p] &= ~KPairCandidate;
+			candidates[i] = candidates[--count];
+			continue;
+			}
+		++i;
+		if(f<minFrequency || p==exclude)
+			continue;
+		TInt tieBreak = TieBreak(aCtx,p&0xff,p>>8);
+		if(f>bestCount || (f==bestCount && tieBreak>bestTieBreak))
 			{
 			bestCount = f;
-			bestByte = b;
+			bestPair = p;
+			bestTieBreak = tieBreak;
+			ties = 1;
 			}
+		else if(f==bestCount && tieBreak==bestTieBreak)
+			++ties;
 		}
-	byte = bestByte;
+	aCtx.iCandidateCount = count;
+
+	if(ties>1)
+		bestPair = ResolveTie(aCtx,data,size,minFrequency,marker,bestCount,bestTieBreak,exclude);
+	pair = bestPair;
 	return bestCount;
 	}
 
 
-TInt Pak(TUint8* dst, TUint8* src, TInt size)
+/**
+Replaces pair with byte and escapes byte itself as Pak() does, and updates pair counts
+for windows of data that changed.
+@return size of output data
+*/
+static TInt SubstitutePair(BytePairContext& aCtx, TUint8* in, TInt size, TUint8* out, TInt marker,
+			TInt byte, TInt pair, TInt& byteCount, TInt& pairCount)
+	{
+	TUint8* (*FindSpecial)(TUint8*, TUint8*, TInt, TInt, TInt) = Kernels(aCtx).iFindSpecial;
+	const TInt b1 = pair&0xff;
+	const TInt b2 = pair>>8;
+	TUint8* inStart = in;
+	TUint8* inEnd = in+size;
+	TUint8* outStart = out;
+
+	// last sync point with no changes after it, in both input and output
+	TUint8* syncIn = in;
+	TUint8* syncOut = out;
+	// start of the window being changed
+	TUint8* winIn = nullptr;
+	TUint8* winOut = nullptr;
+	// previous unit is an escape
+	bool escIn = false;
+	bool escOut = false;
+
+	while(in<inEnd)
+		{
+		TUint8* unitIn = in;
+		TUint8* unitOut = out;
+		TInt b = *in;
+		bool sync;
+		if(b==marker)
+			{
+			*out++ = *in++;
+			*out++ = *in++;
+			sync = true;
+			escIn = escOut = true;
+			}
+		else if(b==byte)
+			{
+			if(!winIn)
+				{
+				winIn = syncIn;
+				winOut = syncOut;
+				}
+			*out++ = (TUint8)marker;
+			*out++ = (TUint8)b;
+			++in;
+			--byteCount;
+			escIn = false;
+			escOut = true;
+			continue;
+			}
+		else if(b==b1 && in+1<inEnd && in[1]==b2)
+			{
+			if(!winIn)
+				{
+				winIn = syncIn;
+				winOut = syncOut;
+				}
+			*out++ = (TUint8)byte;
+			in += 2;
+			--pairCount;
+			escIn = escOut = false;
+			continue;
+			}
+		else if(b==b1)
+			{
+			sync = (escIn || in==inStart || in[-1]!=b) && (escOut || out==outStart || out[-1]!=b);
+			*out++ = *in++;
+			escIn = escOut = false;
+			}
+		else
+			{
+			// copy a span of bytes which are left as is, inside it
+			// a unit is a sync point if it differs from the previous one
+			TUint8* spanEnd = FindSpecial(in+1,inEnd,marker,byte,b1);
+			TInt n = spanEnd-in;
+			sync = (escIn || in==inStart || in[-1]!=b) && (escOut || out==outStart || out[-1]!=b);
+			memcpy(out,in,n);
+			escIn = escOut = false;
+			if(winIn)
+				{
+				// close the window at the first sync point of the span
+				TUint8* p = in;
+				if(!sync)
+					for(++p; p<spanEnd && p[-1]==p[0]; ++p) {}
+				if(p<spanEnd)
+					{
+					TUint8* q = out+(p-in);
+					CountPairs(aCtx,inStart,winIn-inStart,p-inStart,size,marker,false);
+					CountPairs(aCtx,outStart,winOut-outStart,q-outStart,out+n-outStart,marker,true);
+					winIn = nullptr;
+					}
+				}
+			// remember the last sync point of the span
+			TUint8* p = spanEnd-1;
+			while(p>in && p[-1]==p[0])
+				--p;
+			if(p>in || sync)
+				{
+				syncIn = p;
+				syncOut = out+(p-in);
+				}
+			in += n;
+			out += n;
+			continue;
+			}
+
+		if(sync)
+			{
+			if(winIn)
+				{
+				CountPairs(aCtx,inStart,winIn-inStart,unitIn-inStart,size,marker,false);
+				CountPairs(aCtx,outStart,winOut-outStart,unitOut-outStart,out-outStart,marker,true);
+				winIn = nullptr;
+				}
+			syncIn = unitIn;
+			syncOut = unitOut;
+			}
+		}
+
+	TInt outSize = out-outStart;
+	if(winIn)
+		{
+		CountPairs(aCtx,inStart,winIn-inStart,size,size,marker,false);
+		CountPairs(aCtx,outStart,winOut-outStart,outSize,outSize,marker,true);
+		}
+	return outSize;
+	}
+
+
+/**
+Clears counters of all pairs used in incremental mode.
+*/
+static void ResetPairCounts(BytePairContext& aCtx)
+	{
+	TUint16* touched = aCtx.iTouchedPairs;
+	TInt n = aCtx.iTouchedCount;
+	while(n--)
+		{
+		TInt p = touched[n];
+		aCtx.iPairCount[p] = 0;
+		aCtx.iPairState[p] = 0;
+		}
+	aCtx.iTouchedCount = 0;
+	aCtx.iCandidateCount = 0;
+	}
+
+
+static TInt LeastCommonByte(BytePairContext& aCtx, TInt& byte)
+	{
+	return Kernels(aCtx).iLeastCommonByte(aCtx.iByteCount,byte);
+	}
+
+
+TInt Pak(BytePairContext& aCtx, TUint8* dst, TUint8* src, TInt size)
 	{
 	TInt originalSize = size;
 	TUint8* dst2 = dst+size*2;
@@ -161,33 +820,53 @@ TInt Pak(TUint8* dst, TUint8* src, TInt size)
 	TUint8 tokens[0x100*3];
 	TInt tokenCount = 0;
 
-	CountBytes(in,size);
+	CountBytes(aCtx,in,size);
 
 	TInt marker = -1;
-	TInt overhead = 1+3+LeastCommonByte(marker);
-	ByteUsed(marker);
+	TInt overhead = 1+3+LeastCommonByte(aCtx,marker);
+	ByteUsed(aCtx,marker);
 
-	TUint8* inEnd = in+size;
+	TUint8* inEnd;
 	TUint8* outStart = out;
-	while(in<inEnd)
-		{
-		TInt b=*in++;
-		if(b==marker)
-			*out++ = (TUint8)b;
-		*out++ = (TUint8)b;
-		}
+	out = Kernels(aCtx).iEscapeMarker(out,in,size,marker);
 	size = out-outStart;
 
 	TInt outToggle = 1;
 	in = dst;
 	out = dst2;
 
+	const bool incremental = aCtx.iIncremental;
+	if(incremental)
+		{
+		if(aCtx.iPairCountDirty)
+			{
+			memset(aCtx.iPairCount,0,sizeof(aCtx.iPairCount));
+			aCtx.iPairCountDirty = false;
+			}
+		CountPairs(aCtx,in,0,size,size,marker,true);
+		}
+
 	for(TInt r=256; r>0; --r)
 		{
 		TInt byte;
-		TInt byteCount = LeastCommonByte(byte);
+		TInt byteCount = LeastCommonByte(aCtx,byte);
 		TInt pair;
-		TInt pairCount = MostCommonPair(pair,in,size,overhead+1,marker);
+		TInt pairCount = incremental ?
+			MostCommonCandidate(aCtx,pair,in,size,overhead+1,marker,-1) :
+			MostCommonPair(aCtx,pair,in,size,overhead+1,marker,-1);
+		if(tokenCount==aCtx.iDeviation && pair>=0)
+			{
+			// take the runner-up pair instead of the most common one
+			TInt other;
+			TInt otherCount = incremental ?
+				MostCommonCandidate(aCtx,other,in,size,overhead+1,marker,pair) :
+				MostCommonPair(aCtx,other,in,size,overhead+1,marker,pair);
+			if(other>=0)
+				{
+				pair = other;
+				pairCount = otherCount;
+				}
+			}
 		TInt saving = pairCount-byteCount;
 		if(saving<=overhead)
 			break;
@@ -199,39 +878,44 @@ TInt Pak(TUint8* dst, TUint8* src, TInt size)
 		TUint8* d=tokens+3*tokenCount;
 		++tokenCount;
 		*d++ = (TUint8)byte;
-		ByteUsed(byte);
+		ByteUsed(aCtx,byte);
 		*d++ = (TUint8)pair;
-		ByteUsed(pair&0xff);
+		ByteUsed(aCtx,pair&0xff);
 		*d++ = (TUint8)(pair>>8);
-		ByteUsed(pair>>8);
-		++GlobalPairs[pair];
+		ByteUsed(aCtx,pair>>8);
+		++aCtx.iGlobalPairs[pair];
 
-		inEnd = in+size;
-		outStart = out;
-		while(in<inEnd)
+		if(incremental)
+			size = SubstitutePair(aCtx,in,size,out,marker,byte,pair,byteCount,pairCount);
+		else
 			{
-			TInt b=*in++;
-			if(b==marker)
-				{
-				*out++ = (TUint8)marker;
-				b = *in++;
-				}
-			else if(b==byte)
+			inEnd = in+size;
+			outStart = out;
+			while(in<inEnd)
 				{
-				*out++ = (TUint8)marker;
-				--byteCount;
-				}
-			else if(b==(pair&0xff) && in<inEnd && *in==(pair>>8))
-				{
-				++in;
-				b = byte;
-				--pairCount;
+				TInt b=*in++;
+				if(b==marker)
+					{
+					*out++ = (TUint8)marker;
+					b = *in++;
+					}
+				else if(b==byte)
+					{
+					*out++ = (TUint8)marker;
+					--byteCount;
+					}
+				else if(b==(pair&0xff) && in<inEnd && *in==(pair>>8))
+					{
+					++in;
+					b = byte;
+					--pairCount;
+					}
+				*out++ = (TUint8)b;
 				}
-			*out++ = (TUint8)b;
+			size = out-outStart;
 			}
 		assert(!byteCount);
 		assert(!pairCount);
-		size = out-outStart;
 
 		outToggle ^= 1;
 		if(outToggle)
@@ -246,6 +930,9 @@ TInt Pak(TUint8* dst, TUint8* src, TInt size)
 			}
 		}
 
+	if(incremental)
+		ResetPairCounts(aCtx);
+
 	// sort tokens with a bubble sort...
 	for(TInt x=0; x<tokenCount-1; x++)
 		for(TInt y=x+1; y<tokenCount; y++)
@@ -306,13 +993,54 @@ TInt Pak(TUint8* dst, TUint8* src, TInt size)
 	dst += size;
 
 	// get stats...
-	++GlobalTokenCounts[tokenCount];
+	++aCtx.iGlobalTokenCounts[tokenCount];
 
 	// return total size of compressed data...
 	return dst-originalDst;
 	}
 
 
+/**
+Searches for a better token set than the greedy choice of Pak(): packs data
+with every TPakStrategy, then with the runner-up pair taken instead of the most
+common one in each of the first KMaxDeviations rounds, and keeps the smallest
+result. The earlier attempt wins on equal sizes, so the result is never larger
+than the one of Pak().
+@param dst - buffer of size*4 bytes as for Pak()
+*/
+const TInt KMaxDeviations = 4;
+
+TInt PakMax(BytePairContext& aCtx, TUint8* dst, TUint8* src, TInt size)
+	{
+	TInt strategy = aCtx.iStrategy;
+	TInt deviation = aCtx.iDeviation;
+	TInt bestSize = -1;
+	for(TInt attempt=0; attempt<EPakStrategies+KMaxDeviations; attempt++)
+		{
+		if(attempt<EPakStrategies)
+			{
+			aCtx.iStrategy = attempt;
+			aCtx.iDeviation = -1;
+			}
+		else
+			{
+			aCtx.iStrategy = EPakTieBreakBytes;
+			aCtx.iDeviation = attempt-EPakStrategies;
+			}
+		TInt packedSize = Pak(aCtx,dst,src,size);
+		if(bestSize<0 || packedSize<bestSize)
+			{
+			bestSize = packedSize;
+			memcpy(aCtx.iBestBuffer,dst,packedSize);
+			}
+		}
+	aCtx.iStrategy = strategy;
+	aCtx.iDeviation = deviation;
+	memcpy(dst,aCtx.iBestBuffer,bestSize);
+	return bestSize;
+	}
+
+
 TInt Unpak(TUint8* dst, TInt dstSize, TUint8* src, TInt srcSize, TUint8*& srcNext)
 	{
 	TUint8* dstStart = dst;
@@ -464,14 +1192,22 @@ done_d:
 	}
 
 
-TUint8 PakBuffer[MaxBlockSize*4];
-TUint8 UnpakBuffer[MaxBlockSize];
+/**
+Unpak() keeps its lookup tables on the stack, so it is reentrant by itself.
+The overload with context is provided for symmetry with Pak().
+*/
+TInt Unpak(BytePairContext& /*aCtx*/, TUint8* dst, TInt dstSize, TUint8* src, TInt srcSize, TUint8*& srcNext)
+	{
+	return Unpak(dst, dstSize, src, srcSize, srcNext);
+	}
 
 
-TInt BytePairCompress(TUint8* dst, TUint8* src, TInt size)
+TInt BytePairCompress(BytePairContext& aCtx, TUint8* dst, TUint8* src, TInt size)
 	{
+	TUint8* PakBuffer = aCtx.iPakBuffer;
+	TUint8* UnpakBuffer = aCtx.iUnpakBuffer;
 	assert(size<=MaxBlockSize);
-	TInt compressedSize = Pak(PakBuffer,src,size);
+	TInt compressedSize = Pak(aCtx,PakBuffer,src,size);
 	TUint8* pakEnd;
 	TInt us = Unpak(UnpakBuffer,MaxBlockSize,PakBuffer,compressedSize,pakEnd);
 	assert(us==size);
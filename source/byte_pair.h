@@ -19,8 +19,81 @@
 
 #include <portable.h>
 
-TInt BytePairCompress(TUint8* dst, TUint8* src, TInt size);
-TInt Pak(TUint8* dst, TUint8* src, TInt size);
+const TInt MaxBlockSize = 0x1000;
+
+/**
+How Pak() chooses between pairs of equal frequency.
+@internalComponent
+@released
+*/
+enum TPakStrategy
+{
+	EPakTieBreakBytes,	// prefer the pair of rarer bytes, last one found on equal tie break
+	EPakTieBreakFirst,	// prefer the pair of rarer bytes, first one found on equal tie break
+	EPakTieBreakPairs,	// prefer the pair which overlaps fewer other pairs
+	EPakStrategies
+};
+
+/**
+Working tables of the byte pair compressor.
+Pak() keeps all its state here instead of global tables, so every thread
+should own a context. The context can be reused for any number of pages
+without reallocation.
+@internalComponent
+@released
+*/
+struct BytePairContext
+{
+	BytePairContext();
+
+	/**
+	If set (default) Pak() counts pairs once per page and then updates the counts
+	only around substituted positions, otherwise every round rescans the whole page.
+	Both modes produce identical output.
+	*/
+	bool iIncremental;
+	/**
+	If set (default) Pak() uses SSE2 or AVX2 versions of its inner loops when
+	the CPU supports them, otherwise the scalar reference loops.
+	Both modes produce identical output.
+	*/
+	bool iVectorized;
+	/** Pair selection rule, one of TPakStrategy */
+	TInt iStrategy;
+	/** Token number for which Pak() takes the second most common pair, -1 for none */
+	TInt iDeviation;
+
+	TUint16 iPairCount[0x10000];
+	TUint16 iPairBuffer[MaxBlockSize*2];
+	TUint16 iByteCount[0x100+4];
+
+	// incremental mode: state flags of each pair, pairs with non-zero iPairState
+	// and pairs frequent enough to be chosen
+	TUint8 iPairState[0x10000];
+	TUint16 iTouchedPairs[0x10000];
+	TInt iTouchedCount;
+	TUint16 iCandidates[0x10000];
+	TInt iCandidateCount;
+	// incremental mode: occurrence counters for pairs with equal frequency
+	TUint16 iTieCount[0x10000];
+	// iPairCount left dirty by the full rescan mode
+	bool iPairCountDirty;
+
+	// statistics: how many times each pair and each token count were used
+	TUint16 iGlobalPairs[0x10000];
+	TUint16 iGlobalTokenCounts[0x100];
+
+	// buffers for BytePairCompress()
+	TUint8 iPakBuffer[MaxBlockSize*4];
+	TUint8 iUnpakBuffer[MaxBlockSize];
+	// the smallest output found by PakMax()
+	TUint8 iBestBuffer[MaxBlockSize*2];
+};
+
+TInt BytePairCompress(BytePairContext& aContext, TUint8* dst, TUint8* src, TInt size);
+TInt Pak(BytePairContext& aContext, TUint8* dst, TUint8* src, TInt size);
+TInt PakMax(BytePairContext& aContext, TUint8* dst, TUint8* src, TInt size);
+TInt Unpak(BytePairContext& aContext, TUint8* dst, TInt dstSize, TUint8* src, TInt srcSize, TUint8*& srcNext);
 TInt Unpak(TUint8* dst, TInt dstSize, TUint8* src, TInt srcSize, TUint8*& srcNext);
 
 #endif
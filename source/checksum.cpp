@@ -17,9 +17,14 @@
 // @released
 //
 //
-
+
 #include <portable.h>
 #include "checksum.h"
+#include "cpufeatures.h"
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
 
 typedef unsigned char uint8;
 
@@ -75,6 +80,8 @@ static const uint32_t crcTab[256] =
 	0x3eb2,0x0ed1,0x1ef0
 };
 
+static uint32_t CrcSlice8(uint32_t crc, const uint8 * pB, const uint8 * pE);
+
 /**
 Performs a CCITT CRC checksum on the specified data.
 
@@ -89,13 +96,8 @@ value.
 */
 unsigned short Crc(const void * aPtr, uint32_t aLength)
 {
-
 	const uint8 * pB=(const uint8 *)aPtr;
-	const uint8 * pE=pB+aLength;
-	uint32_t crc=0;
-    while (pB<pE)
-		crc=(crc<<8)^crcTab[((crc>>8)^*pB++)&0xff];
-	return crc;
+	return CrcSlice8(0, pB, pB+aLength);
 }
 
 //crc table
@@ -167,6 +169,185 @@ static const uint32_t CrcTab32[256] =
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 	};
 
+/*
+Reference implementation of Crc(), one byte per iteration.
+*/
+static uint32_t CrcBytes(uint32_t crc, const uint8 * pB, const uint8 * pE)
+{
+	while (pB<pE)
+		crc=(crc<<8)^crcTab[((crc>>8)^*pB++)&0xff];
+	return crc & 0xffff;
+}
+
+/*
+Slice-by-8 tables: entry [k][b] is the CRC of byte b followed by k zero bytes,
+so eight input bytes are folded into the CRC with eight independent lookups.
+*/
+struct CrcSliceTables
+{
+	CrcSliceTables()
+	{
+		for(uint32_t b = 0; b < 256; b++)
+		{
+			iCrc16[0][b] = (uint16_t)crcTab[b];
+			iCrc32[0][b] = CrcTab32[b];
+		}
+		for(int k = 1; k < 8; k++)
+			for(uint32_t b = 0; b < 256; b++)
+			{
+				uint32_t c16 = iCrc16[k - 1][b];
+				iCrc16[k][b] = (uint16_t)((c16 << 8) ^ crcTab[c16 >> 8]);
+				uint32_t c32 = iCrc32[k - 1][b];
+				iCrc32[k][b] = (c32 >> 8) ^ CrcTab32[c32 & 0xff];
+			}
+	}
+
+	static const CrcSliceTables& Get()
+	{
+		static const CrcSliceTables iTables;
+		return iTables;
+	}
+
+	uint16_t iCrc16[8][256];
+	uint32_t iCrc32[8][256];
+};
+
+static uint32_t CrcSlice8(uint32_t crc, const uint8 * pB, const uint8 * pE)
+{
+	const CrcSliceTables& t = CrcSliceTables::Get();
+	while (pE - pB >= 8)
+	{
+		crc = t.iCrc16[7][(crc >> 8) ^ pB[0]] ^ t.iCrc16[6][(crc & 0xff) ^ pB[1]] ^
+			t.iCrc16[5][pB[2]] ^ t.iCrc16[4][pB[3]] ^ t.iCrc16[3][pB[4]] ^
+			t.iCrc16[2][pB[5]] ^ t.iCrc16[1][pB[6]] ^ t.iCrc16[0][pB[7]];
+		pB += 8;
+	}
+	return CrcBytes(crc, pB, pE);
+}
+
+/*
+Reference implementation of Crc32Update(), one byte per iteration.
+*/
+static uint32_t Crc32Bytes(uint32_t crc, const uint8 * p, const uint8 * q)
+{
+	while (p < q)
+		crc = (crc >> 8) ^ CrcTab32[(crc ^ *p++) & 0xff];
+	return crc;
+}
+
+static uint32_t Crc32Slice8(uint32_t crc, const uint8 * p, const uint8 * q)
+{
+	const CrcSliceTables& t = CrcSliceTables::Get();
+	while (q - p >= 8)
+	{
+		uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+		crc = t.iCrc32[7][lo & 0xff] ^ t.iCrc32[6][(lo >> 8) & 0xff] ^
+			t.iCrc32[5][(lo >> 16) & 0xff] ^ t.iCrc32[4][lo >> 24] ^
+			t.iCrc32[3][p[4]] ^ t.iCrc32[2][p[5]] ^ t.iCrc32[1][p[6]] ^ t.iCrc32[0][p[7]];
+		p += 8;
+	}
+	return Crc32Bytes(crc, p, q);
+}
+
+#if defined(CPU_X86)
+/*
+Folds 64 byte blocks with carry-less multiplication and reduces the remainder
+with Barrett reduction, see Intel's "Fast CRC Computation for Generic
+Polynomials Using PCLMULQDQ Instruction". The constants are powers of x modulo
+the CRC-32 polynomial, bit reflected. Needs at least 64 bytes, consumes a
+multiple of 16 bytes and leaves the rest to the caller.
+*/
+TARGET_PCLMUL static uint32_t Crc32Clmul(uint32_t crc, const uint8 *& p, const uint8 * q)
+{
+	alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+	alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+	alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+	alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	__m128i k = _mm_load_si128((const __m128i*)k1k2);
+	p += 64;
+
+	while (q - p >= 64)
+	{
+		__m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+		__m128i x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+		__m128i x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+		__m128i x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(p + 0x30)));
+		p += 64;
+	}
+
+	// fold the four lanes into one, then any remaining 16 byte blocks
+	k = _mm_load_si128((const __m128i*)k3k4);
+	__m128i lanes[3] = { x2, x3, x4 };
+	for (int i = 0; i < 3; i++)
+	{
+		__m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), lanes[i]);
+	}
+	while (q - p >= 16)
+	{
+		__m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)p));
+		p += 16;
+	}
+
+	// 128 to 64 bits
+	__m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	k = _mm_loadl_epi64((const __m128i*)k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	k = _mm_load_si128((const __m128i*)poly);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), k, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return _mm_extract_epi32(x1, 1);
+}
+#endif // CPU_X86
+
+/**
+Continues a CRC-32 checksum with the next part of the data, so the data can be
+checksummed as it is produced. Crc32Update(Crc32Update(0, a, n), b, m) equals
+the Crc32() of a followed by b.
+
+@param aCrc		The value returned for the previous part, 0 for the first one.
+@param aPtr		A pointer to the start of the data to be checksummed.
+@param aLength	The length of the data to be checksummed.
+@return         A 32 bit integer contain the CRC value.
+@internalComponent
+@released
+*/
+uint32_t Crc32Update(uint32_t aCrc, const void * aPtr, size_t aLength)
+{
+	const uint8 * p = (const uint8 *)aPtr;
+	const uint8 * q = p + aLength;
+#if defined(CPU_X86)
+	static const bool clmul = CpuFeatures::Get().iPCLMUL;
+	if (clmul && aLength >= 64)
+		aCrc = Crc32Clmul(aCrc, p, q);
+#endif
+	return Crc32Slice8(aCrc, p, q);
+}
+
 /**
 Performs a CCITT CRC-32 checksum on the specified data.
 
@@ -181,11 +362,5 @@ value.
 */
 uint32_t Crc32(const void * aPtr, uint32_t aLength)
 {
-	const uint8 * p = (const uint8 *)aPtr;
-	const uint8 * q = p + aLength;
-	uint32_t crc = 0;
-	while (p < q)
-		crc = (crc >> 8) ^ CrcTab32[(crc ^ *p++) & 0xff];
-	return crc;
+	return Crc32Update(0, aPtr, aLength);
 }
-
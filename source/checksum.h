@@ -20,11 +20,12 @@
 
 #ifndef CHECKSUM_H
 #define CHECKSUM_H
-
+
 #include <cstddef>
 uint32_t checkSum(const void *aPtr);
 uint16_t Crc(const void * aPtr,uint32_t aLength);
 uint32_t Crc32(const void * aPtr, uint32_t aLength);
+uint32_t Crc32Update(uint32_t aCrc, const void * aPtr, size_t aLength);
 
 #endif // CHECKSUM_H
 
@@ -0,0 +1,92 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Implementation of the runtime CPU features detection for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#include "cpufeatures.h"
+
+#if defined(CPU_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void CpuId(unsigned aLeaf, unsigned aSubLeaf, unsigned aRegs[4])
+{
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, aLeaf, aSubLeaf);
+    for(int i = 0; i < 4; i++)
+        aRegs[i] = regs[i];
+#else
+    __cpuid_count(aLeaf, aSubLeaf, aRegs[0], aRegs[1], aRegs[2], aRegs[3]);
+#endif
+}
+
+/** Returns XCR0 register: which register sets the OS saves on context switch */
+static unsigned long long XGetBv()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+static CpuFeatures Detect()
+{
+    CpuFeatures f;
+    unsigned regs[4];
+    CpuId(0, 0, regs);
+    unsigned maxLeaf = regs[0];
+    if(maxLeaf < 1)
+        return f;
+
+    CpuId(1, 0, regs);
+    f.iSSE2 = (regs[3] >> 26) & 1;
+    f.iSSE41 = (regs[2] >> 19) & 1;
+    f.iPCLMUL = f.iSSE41 && ((regs[2] >> 1) & 1);
+
+    bool osxsave = (regs[2] >> 27) & 1;
+    bool avx = (regs[2] >> 28) & 1;
+    // AVX registers are usable only if the OS saves XMM and YMM state
+    if(!osxsave || !avx || (XGetBv() & 6) != 6 || maxLeaf < 7)
+        return f;
+    CpuId(7, 0, regs);
+    f.iAVX2 = (regs[1] >> 5) & 1;
+    return f;
+}
+#else
+static CpuFeatures Detect()
+{
+    return CpuFeatures();
+}
+#endif // CPU_X86
+
+/**
+Function returns features of the host CPU detected on first call.
+@internalComponent
+@released
+*/
+const CpuFeatures& CpuFeatures::Get()
+{
+    static const CpuFeatures iFeatures = Detect();
+    return iFeatures;
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Runtime detection of the host CPU instruction set extensions for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define CPU_X86 1
+#endif
+
+// Functions which use instruction set extensions beyond the baseline should be
+// marked with these and called only if the matching CpuFeatures flag is set.
+#if defined(CPU_X86) && defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_PCLMUL __attribute__((target("sse4.1,pclmul")))
+#else
+#define TARGET_SSE2
+#define TARGET_SSE41
+#define TARGET_AVX2
+#define TARGET_PCLMUL
+#endif
+
+/**
+Instruction set extensions supported by the host CPU and operating system.
+All flags are false on non-x86 hosts so the callers use the portable code.
+@internalComponent
+@released
+*/
+struct CpuFeatures
+{
+    static const CpuFeatures& Get();
+
+    bool iSSE2 = false;
+    bool iSSE41 = false;
+    bool iAVX2 = false;
+    bool iPCLMUL = false;
+};
+
+#endif // CPUFEATURES_H
@@ -148,7 +148,7 @@ void DefFile::Tokenizer(std::string aLine, size_t aIndex)
     if(pos < string::npos)
     {
         std::string comment = aLine.substr(pos);
-        iSymbol->Comment(comment);
+        iSymbol->Comment(comment.c_str());
         aLine.erase(pos);
     }
 
@@ -274,7 +274,7 @@ void WriteDefString(Symbol *sym, std::fstream &fstr)
     if(sym->Absent())
         fstr << " ABSENT";
 
-    if(!sym->Comment().empty())
+    if(*sym->Comment())
     {
         fstr << " ; ";
         fstr << sym->Comment();
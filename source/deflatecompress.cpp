@@ -19,15 +19,27 @@
 #include <algorithm>
 #include <string.h>
 #include <type_traits>
+#include <vector>
 
 #include "errorhandler.h"
 #include "farray.h"
 #include "huffman.h"
+#include "workerpool.h"
+#include "pagedcompress.h"
 
 using std::min;
 
 
-void DeflateL(const TUint8* aBuf, TInt aLength, TBitOutput& aOutput);
+void DeflateL(const TUint8* aBuf, TInt aLength, TBitOutput& aOutput, CompressionLevel aLevel);
+
+// data larger than this is searched for matches in parallel chunks of this size
+const TInt KDeflateChunkSize=0x10000;
+// hash chain steps searched for a match by ECompressionFast
+const TInt KDeflateFastDepth=16;
+// ECompressionMax: parses with the cost model from the previous parse, and the cost
+// in bits of codes the previous parse didn't use
+const TInt KDeflateOptimalPasses=2;
+const TUint32 KDeflateUnusedCost=16;
 
 /**
 Class HDeflateHash
@@ -51,6 +63,21 @@ class HDeflateHash
 		TOffset iOffset[1];	// or more
 };
 
+/**
+Cost in bits of every literal, match length and match distance for the optimal parse,
+extra bits included
+@internalComponent
+@released
+*/
+struct TDeflateCosts
+{
+	TDeflateCosts(const TEncoding& aFrequency);
+
+	TUint32 iLiteral[TEncoding::ELiterals];
+	TUint32 iLength[KDeflateMaxLength+1];
+	TUint32 iDistance[KDeflateMaxDistance+1];
+};
+
 /**
 Class MDeflater
 @internalComponent
@@ -59,16 +86,34 @@ Class MDeflater
 class MDeflater
 {
 	public:
+		inline MDeflater();
+		inline void SetLevel(CompressionLevel aLevel,const TDeflateCosts* aCosts);
 		void DeflateL(const TUint8* aBase,TInt aLength);
+		void DeflateChunkL(const TUint8* aBase,const TUint8* aStart,const TUint8* aEnd);
+		static TInt LengthCode(TInt aLength,TInt& aExtra);
+		static TInt DistanceCode(TInt aDistance,TInt& aExtra);
 	private:
-		const TUint8* DoDeflateL(const TUint8* aBase,const TUint8* aEnd,HDeflateHash& aHash);
-		static TInt Match(const TUint8* aPtr,const TUint8* aEnd,TInt aPos,HDeflateHash& aHas);
+		const TUint8* DoDeflateL(const TUint8* aBase,const TUint8* aStart,const TUint8* aEnd,HDeflateHash& aHash);
+		const TUint8* DoDeflateFastL(const TUint8* aBase,const TUint8* aStart,const TUint8* aEnd,HDeflateHash& aHash);
+		const TUint8* DoDeflateOptimalL(const TUint8* aBase,const TUint8* aStart,const TUint8* aEnd,HDeflateHash& aHash);
+		static TInt Match(const TUint8* aPtr,const TUint8* aEnd,TInt aPos,HDeflateHash& aHash,TInt aDepth=KDeflateMaxDistance);
+		static TInt Matches(const TUint8* aPtr,const TUint8* aEnd,TInt aPos,HDeflateHash& aHash,TInt aDistances[]);
 		void SegmentL(TInt aLength,TInt aDistance);
 		virtual void LitLenL(TInt aCode) =0;
 		virtual void OffsetL(TInt aCode) =0;
 		virtual void ExtraL(TInt aLen,TUint aBits) =0;
+	private:
+		CompressionLevel iLevel;
+		const TDeflateCosts* iCosts;	// cost model of ECompressionMax, none for the first parse
 };
 
+/**
+Token stream recorded by TDeflateStats, one word per LitLenL(), OffsetL() or ExtraL() call
+@internalComponent
+@released
+*/
+typedef std::vector<TUint32> TDeflateTokens;
+
 /**
 Class TDeflateStats
 @internalComponent
@@ -77,7 +122,9 @@ Class TDeflateStats
 class TDeflateStats : public MDeflater
 {
 	public:
-		explicit inline TDeflateStats(TEncoding& aEncoding);
+		enum {ELitLenToken=0, EOffsetToken=1u<<30, EExtraToken=2u<<30, ETokenMask=3u<<30};
+	public:
+		inline TDeflateStats(TEncoding& aEncoding,TDeflateTokens& aTokens);
 	private:
 		// from MDeflater
 		void LitLenL(TInt aCode);
@@ -85,6 +132,7 @@ class TDeflateStats : public MDeflater
 		void ExtraL(TInt aLen,TUint aBits);
 	private:
 		TEncoding& iEncoding;
+		TDeflateTokens& iTokens;
 };
 
 /**
@@ -96,6 +144,7 @@ class TDeflater : public MDeflater
 {
 	public:
 		inline TDeflater(TBitOutput& aOutput,const TEncoding& aEncoding);
+		void ReplayL(const TDeflateTokens& aTokens);
 	private:
 		// from MDeflater
 		void LitLenL(TInt aCode);
@@ -205,7 +254,7 @@ Function Match
 @internalComponent
 @released
 */
-TInt MDeflater::Match(const TUint8* aPtr,const TUint8* aEnd,TInt aPos,HDeflateHash& aHash)
+TInt MDeflater::Match(const TUint8* aPtr,const TUint8* aEnd,TInt aPos,HDeflateHash& aHash,TInt aDepth)
 {
 	TInt offset=aHash.First(aPtr,aPos);
 	if (offset>KDeflateMaxDistance)
@@ -235,22 +284,59 @@ TInt MDeflater::Match(const TUint8* aPtr,const TUint8* aEnd,TInt aPos,HDeflateHa
 			}
 		}
 		offset=aHash.Next(aPos,offset);
-	} while (offset<=KDeflateMaxDistance);
+	} while (offset<=KDeflateMaxDistance && --aDepth>0);
 	return match;
 }
 
+/**
+Function Matches
+Find the nearest match of every length for the optimal parse
+@param aPtr
+@param aEnd
+@param aPos
+@param aHash
+@param aDistances - receives the smallest distance of a match for each length
+@return the longest match length, or 0 if there is no match
+@internalComponent
+@released
+*/
+TInt MDeflater::Matches(const TUint8* aPtr,const TUint8* aEnd,TInt aPos,HDeflateHash& aHash,TInt aDistances[])
+{
+	TInt offset=aHash.First(aPtr,aPos);
+	TInt longest=0;
+	TInt limit=(min)(TInt(aEnd-aPtr),KDeflateMaxLength);
+	while (offset<=KDeflateMaxDistance && longest<limit)
+	{
+		const TUint8* p=aPtr-offset;
+		if (p[longest]==aPtr[longest])
+		{	// might be longer
+			TInt len=0;
+			while (len<limit && p[len]==aPtr[len])
+				++len;
+			for (;longest<len;)
+				aDistances[++longest]=offset;
+		}
+		offset=aHash.Next(aPos,offset);
+	}
+	return longest;
+}
+
 /*
-Apply the deflation algorithm to the data [aBase,aEnd)
+Apply the deflation algorithm to the data [aStart,aEnd), data [aBase,aStart) is only
+added to the hash as the history for matches
 Return a pointer after the last byte that was deflated (which may not be aEnd)
 @param aBase
+@param aStart
 @param aEnd
 @param aHash
 @internalComponent
 @released
 */
-const TUint8* MDeflater::DoDeflateL(const TUint8* aBase,const TUint8* aEnd,HDeflateHash& aHash)
+const TUint8* MDeflater::DoDeflateL(const TUint8* aBase,const TUint8* aStart,const TUint8* aEnd,HDeflateHash& aHash)
 {
 	const TUint8* ptr=aBase;
+	for (;ptr<aStart;++ptr)
+		aHash.First(ptr,ptr-aBase);
 	TInt prev=0;		// the previous deflation match
 	do
 	{
@@ -300,17 +386,39 @@ The generic deflation algorithm
 */
 void MDeflater::DeflateL(const TUint8* aBase,TInt aLength)
 {
-	const TUint8* end=aBase+aLength;
-	if (aLength>KDeflateMinLength)
+	DeflateChunkL(aBase,aBase,aBase+aLength);
+	LitLenL(TEncoding::EEos);	// eos marker
+}
+
+/*
+The generic deflation algorithm for the part [aStart,aEnd) of the data starting at aBase.
+Matches may refer up to KDeflateMaxDistance bytes before aStart but never reach aEnd,
+so the codes of consecutive chunks can be joined into one stream.
+No eos marker is emitted.
+@param aBase
+@param aStart
+@param aEnd
+@internalComponent
+@released
+*/
+void MDeflater::DeflateChunkL(const TUint8* aBase,const TUint8* aStart,const TUint8* aEnd)
+{
+	if (aStart-aBase>KDeflateMaxDistance)
+		aBase=aStart-KDeflateMaxDistance;
+	if (aEnd-aStart>KDeflateMinLength)
 	{	// deflation kicks in if there is enough data
-		HDeflateHash* hash=HDeflateHash::NewLC(aLength);
+		HDeflateHash* hash=HDeflateHash::NewLC(aEnd-aBase);
 
-		aBase=DoDeflateL(aBase,end,*hash);
+		if (iLevel==ECompressionFast)
+			aStart=DoDeflateFastL(aBase,aStart,aEnd,*hash);
+		else if (iLevel==ECompressionMax && iCosts)
+			aStart=DoDeflateOptimalL(aBase,aStart,aEnd,*hash);
+		else
+			aStart=DoDeflateL(aBase,aStart,aEnd,*hash);
 		delete hash;
 	}
-	while (aBase<end)					// emit remaining bytes
-		LitLenL(*aBase++);
-	LitLenL(TEncoding::EEos);	// eos marker
+	while (aStart<aEnd)					// emit remaining bytes
+		LitLenL(*aStart++);
 }
 
 /*
@@ -323,40 +431,192 @@ LitLen(), Offset() and Extra() functions.
 */
 void MDeflater::SegmentL(TInt aLength,TInt aDistance)
 {
-	aLength-=KDeflateMinLength;
-	TInt extralen=0;
-	TUint len=aLength;
+	TInt extralen;
+	TInt code=LengthCode(aLength,extralen);
+	LitLenL(code+TEncoding::ELiterals);
+	if (extralen)
+		ExtraL(extralen,aLength-KDeflateMinLength);
+//
+	code=DistanceCode(aDistance,extralen);
+	OffsetL(code);
+	if (extralen)
+		ExtraL(extralen,aDistance-1);
+}
+
+/*
+Function LengthCode
+@param aLength - match length
+@param aExtra - receives the number of extra bits
+@return the length code, relative to TEncoding::ELiterals
+@internalComponent
+@released
+*/
+TInt MDeflater::LengthCode(TInt aLength,TInt& aExtra)
+{
+	aExtra=0;
+	TUint len=aLength-KDeflateMinLength;
 	while (len>=8)
 	{
-		++extralen;
+		++aExtra;
 		len>>=1;
 	}
-	LitLenL((extralen<<2)+len+TEncoding::ELiterals);
-	if (extralen)
-		ExtraL(extralen,aLength);
-//
-	aDistance--;
-	extralen=0;
-	TUint dist=aDistance;
+	return (aExtra<<2)+len;
+}
+
+/*
+Function DistanceCode
+@param aDistance - match distance
+@param aExtra - receives the number of extra bits
+@return the distance code
+@internalComponent
+@released
+*/
+TInt MDeflater::DistanceCode(TInt aDistance,TInt& aExtra)
+{
+	aExtra=0;
+	TUint dist=aDistance-1;
 	while (dist>=8)
 	{
-		++extralen;
+		++aExtra;
 		dist>>=1;
 	}
-	OffsetL((extralen<<2)+dist);
-	if (extralen)
-		ExtraL(extralen,aDistance);
+	return (aExtra<<2)+dist;
+}
+
+/**
+Constructor for class MDeflater
+@internalComponent
+@released
+*/
+inline MDeflater::MDeflater()
+	:iLevel(ECompressionNormal),iCosts(nullptr)
+	{}
+
+/*
+Function SetLevel
+@param aLevel - compression effort
+@param aCosts - cost model for the optimal parse of ECompressionMax
+@internalComponent
+@released
+*/
+inline void MDeflater::SetLevel(CompressionLevel aLevel,const TDeflateCosts* aCosts)
+	{
+	iLevel=aLevel;
+	iCosts=aCosts;
+	}
+
+/*
+Apply the deflation algorithm to the data [aStart,aEnd) as DoDeflateL() does but for speed:
+only a few hash chain steps are searched and the match found is taken at once
+@param aBase
+@param aStart
+@param aEnd
+@param aHash
+@internalComponent
+@released
+*/
+const TUint8* MDeflater::DoDeflateFastL(const TUint8* aBase,const TUint8* aStart,const TUint8* aEnd,HDeflateHash& aHash)
+{
+	const TUint8* ptr=aBase;
+	for (;ptr<aStart;++ptr)
+		aHash.First(ptr,ptr-aBase);
+	do
+	{
+		TInt match=Match(ptr,aEnd,ptr-aBase,aHash,KDeflateFastDepth);
+		if (match<=(KDeflateMinLength<<16))
+		{
+			LitLenL(*ptr++);	// no deflation match here
+			continue;
+		}
+		TInt len=match>>16;
+		SegmentL(len,match-(len<<16));
+		const TUint8* e=ptr+len;
+		while (++ptr<e)
+		{
+			if (ptr+2<aEnd)
+				aHash.First(ptr,ptr-aBase);
+		}
+	} while (ptr+KDeflateMinLength-1<aEnd);
+	return ptr;
+}
+
+/*
+Apply the deflation algorithm to the data [aStart,aEnd) choosing the literals and matches
+with the lowest total cost in the cost model, instead of the longest match at each position
+@param aBase
+@param aStart
+@param aEnd
+@param aHash
+@internalComponent
+@released
+*/
+const TUint8* MDeflater::DoDeflateOptimalL(const TUint8* aBase,const TUint8* aStart,const TUint8* aEnd,HDeflateHash& aHash)
+{
+	const TUint8* ptr=aBase;
+	for (;ptr<aStart;++ptr)
+		aHash.First(ptr,ptr-aBase);
+
+	// cheapest cost to reach each position and the step reaching it: (length<<16)|distance, 0 for a literal
+	TInt size=aEnd-aStart;
+	std::vector<TUint32> cost(size+1,0xffffffffu);
+	std::vector<TInt> step(size+1,0);
+	TInt distances[KDeflateMaxLength+1];
+	cost[0]=0;
+	for (TInt i=0;i<size;++i)
+	{
+		TUint32 c=cost[i]+iCosts->iLiteral[aStart[i]];
+		if (c<cost[i+1])
+		{
+			cost[i+1]=c;
+			step[i+1]=0;
+		}
+		if (i+KDeflateMinLength-1>=size)
+			continue;
+		TInt longest=Matches(aStart+i,aEnd,aStart+i-aBase,aHash,distances);
+		for (TInt len=KDeflateMinLength;len<=longest;++len)
+		{
+			c=cost[i]+iCosts->iLength[len]+iCosts->iDistance[distances[len]];
+			if (c<cost[i+len])
+			{
+				cost[i+len]=c;
+				step[i+len]=(len<<16)|distances[len];
+			}
+		}
+	}
+
+	// follow the steps back from the end, keeping each one at the position it starts from,
+	// then emit them forwards
+	TInt pos=size;
+	while (pos>0)
+	{
+		TInt s=step[pos];
+		pos-=s ? s>>16 : 1;
+		cost[pos]=s;
+	}
+	for (pos=0;pos<size;)
+	{
+		TInt s=cost[pos];
+		if (s==0)
+		{
+			LitLenL(aStart[pos++]);
+			continue;
+		}
+		TInt len=s>>16;
+		SegmentL(len,s-(len<<16));
+		pos+=len;
+	}
+	return aEnd;
 }
 
 /**
 Class TDeflateStats
 This class analyses the data stream to generate the frequency tables
-for the deflation algorithm
+for the deflation algorithm and records the codes for TDeflater::ReplayL()
 @internalComponent
 @released
 */
-inline TDeflateStats::TDeflateStats(TEncoding& aEncoding)
-	:iEncoding(aEncoding)
+inline TDeflateStats::TDeflateStats(TEncoding& aEncoding,TDeflateTokens& aTokens)
+	:iEncoding(aEncoding),iTokens(aTokens)
 	{}
 /*
 Function LitLenL
@@ -368,6 +628,7 @@ Function LitLenL
 void TDeflateStats::LitLenL(TInt aCode)
 	{
 	++iEncoding.iLitLen[aCode];
+	iTokens.push_back(ELitLenToken|aCode);
 	}
 
 /*
@@ -380,6 +641,7 @@ Finction OffsetL
 void TDeflateStats::OffsetL(TInt aCode)
 	{
 	++iEncoding.iDistance[aCode];
+	iTokens.push_back(EOffsetToken|aCode);
 	}
 
 /*
@@ -387,8 +649,10 @@ Function ExtraL
 @Leave
 @internalComponent
 @released
-*/void TDeflateStats::ExtraL(TInt,TUint)
-	{}
+*/void TDeflateStats::ExtraL(TInt aLen,TUint aBits)
+	{
+	iTokens.push_back(EExtraToken|(aLen<<16)|(aBits&0xffff));
+	}
 
 /**
 Constructor of Class TDeflater
@@ -439,6 +703,167 @@ void TDeflater::ExtraL(TInt aLen,TUint aBits)
 	{
 	iOutput.WriteL(aBits,aLen);
 	}
+
+/*
+Function ReplayL
+Encode the codes recorded by TDeflateStats instead of searching the data for matches again
+@Leave
+@param aTokens
+@internalComponent
+@released
+*/
+void TDeflater::ReplayL(const TDeflateTokens& aTokens)
+	{
+	for (TDeflateTokens::const_iterator p=aTokens.begin();p!=aTokens.end();++p)
+		{
+		TUint32 token=*p;
+		switch (token&TDeflateStats::ETokenMask)
+			{
+		case TDeflateStats::ELitLenToken:
+			LitLenL(token);
+			break;
+		case TDeflateStats::EOffsetToken:
+			OffsetL(token&~TDeflateStats::ETokenMask);
+			break;
+		default:
+			ExtraL((token&~TDeflateStats::ETokenMask)>>16,token&0xffff);
+			break;
+			}
+		}
+	}
+/*
+Function CodeLengths
+@Leave
+@param aFrequency - frequency of each code
+@param aLengths - receives the huffman code length of each code
+@internalComponent
+@released
+*/
+static void CodeLengthsL(const TEncoding& aFrequency,TEncoding& aLengths)
+	{
+	Huffman::HuffmanL(aFrequency.iLitLen,TEncoding::ELitLens,aLengths.iLitLen);
+	Huffman::HuffmanL(aFrequency.iDistance,TEncoding::EDistances,aLengths.iDistance);
+	}
+
+/*
+Function EncodedSize
+@Leave
+@param aFrequency - frequency of each code
+@return size in bits of the codes and extra bits, without the encoding table
+@internalComponent
+@released
+*/
+static TUint64 EncodedSize(const TEncoding& aFrequency)
+	{
+	TEncoding* lengths=new TEncoding();
+	CodeLengthsL(aFrequency,*lengths);
+	TUint64 size=0;
+	for (TInt i=0;i<TEncoding::ELitLens;++i)
+		{
+		TInt code=i-TEncoding::ELiterals;
+		TInt extra=(code>=8 && i!=TEncoding::EEos) ? (code>>2)-1 : 0;
+		size+=TUint64(aFrequency.iLitLen[i])*(lengths->iLitLen[i]+extra);
+		}
+	for (TInt i=0;i<TEncoding::EDistances;++i)
+		{
+		TInt extra=i>=8 ? (i>>2)-1 : 0;
+		size+=TUint64(aFrequency.iDistance[i])*(lengths->iDistance[i]+extra);
+		}
+	delete lengths;
+	return size;
+	}
+
+/**
+Constructor for struct TDeflateCosts
+Builds the cost model from the huffman code lengths the frequencies give
+@param aFrequency - frequency of each code
+@internalComponent
+@released
+*/
+TDeflateCosts::TDeflateCosts(const TEncoding& aFrequency)
+	{
+	TEncoding* lengths=new TEncoding();
+	CodeLengthsL(aFrequency,*lengths);
+	for (TInt i=0;i<TEncoding::ELiterals;++i)
+		iLiteral[i]=lengths->iLitLen[i] ? lengths->iLitLen[i] : KDeflateUnusedCost;
+	TInt extra;
+	for (TInt len=0;len<=KDeflateMaxLength;++len)
+		{
+		if (len<KDeflateMinLength)
+			{
+			iLength[len]=0;
+			continue;
+			}
+		TInt code=MDeflater::LengthCode(len,extra)+TEncoding::ELiterals;
+		iLength[len]=(lengths->iLitLen[code] ? lengths->iLitLen[code] : KDeflateUnusedCost)+extra;
+		}
+	iDistance[0]=0;
+	for (TInt dist=1;dist<=KDeflateMaxDistance;++dist)
+		{
+		TInt code=MDeflater::DistanceCode(dist,extra);
+		iDistance[dist]=(lengths->iDistance[code] ? lengths->iDistance[code] : KDeflateUnusedCost)+extra;
+		}
+	delete lengths;
+	}
+
+/*
+Function AnalyseL
+Analyse the data for symbol frequency and record the codes
+@Leave
+@param aBuf
+@param aLength
+@param aEncoding - receives the frequency of each code
+@param aTokens - receives the codes
+@param aLevel
+@param aCosts - cost model of the optimal parse
+@internalComponent
+@released
+*/
+void AnalyseL(const TUint8* aBuf,TInt aLength,TEncoding& aEncoding,TDeflateTokens& aTokens,
+		CompressionLevel aLevel,const TDeflateCosts* aCosts)
+	{
+	memset(&aEncoding,0,sizeof(TEncoding));
+	aTokens.clear();
+	if (aLength<=KDeflateChunkSize)
+	{
+		aTokens.reserve(aLength/2+1);
+		TDeflateStats analyser(aEncoding,aTokens);
+		analyser.SetLevel(aLevel,aCosts);
+		analyser.DeflateL(aBuf,aLength);
+		return;
+	}
+
+	// chunks are searched for matches in parallel then joined in order,
+	// the chunk size is fixed so the output doesn't depend on the number of workers
+	TInt chunks=(aLength+KDeflateChunkSize-1)/KDeflateChunkSize;
+	std::vector<TEncoding> encodings(chunks);
+	std::vector<TDeflateTokens> chunkTokens(chunks);
+	WorkerPool::GetInstance()->ParallelFor(chunks,[&](size_t aChunk,size_t)
+	{
+		const TUint8* start=aBuf+aChunk*KDeflateChunkSize;
+		const TUint8* end=(min)(start+KDeflateChunkSize,aBuf+aLength);
+		chunkTokens[aChunk].reserve(KDeflateChunkSize/2);
+		TDeflateStats analyser(encodings[aChunk],chunkTokens[aChunk]);
+		analyser.SetLevel(aLevel,aCosts);
+		analyser.DeflateChunkL(aBuf,start,end);
+	});
+
+	size_t count=1;
+	for (TInt i=0;i<chunks;++i)
+		count+=chunkTokens[i].size();
+	aTokens.reserve(count);
+	for (TInt i=0;i<chunks;++i)
+	{
+		aTokens.insert(aTokens.end(),chunkTokens[i].begin(),chunkTokens[i].end());
+		for (TInt j=0;j<TEncoding::ELitLens;++j)
+			aEncoding.iLitLen[j]+=encodings[i].iLitLen[j];
+		for (TInt j=0;j<TEncoding::EDistances;++j)
+			aEncoding.iDistance[j]+=encodings[i].iDistance[j];
+	}
+	++aEncoding.iLitLen[TEncoding::EEos];	// eos marker
+	aTokens.push_back(TDeflateStats::ELitLenToken|TEncoding::EEos);
+	}
+
 /*
 Function DoDeflateL
 @Leave
@@ -446,14 +871,35 @@ Function DoDeflateL
 @param aLength
 @param aOutput
 @param aEncoding
+@param aLevel
 @internalComponent
 @released
 */
-void DoDeflateL(const TUint8* aBuf,TInt aLength,TBitOutput& aOutput,TEncoding& aEncoding)
+void DoDeflateL(const TUint8* aBuf,TInt aLength,TBitOutput& aOutput,TEncoding& aEncoding,CompressionLevel aLevel)
+	{
+	TDeflateTokens tokens;
+	AnalyseL(aBuf,aLength,aEncoding,tokens,aLevel,nullptr);
+	if (aLevel==ECompressionMax)
 	{
-// analyse the data for symbol frequency
-	TDeflateStats analyser(aEncoding);
-	analyser.DeflateL(aBuf,aLength);
+		// parse again with the code lengths of the previous parse as the cost model,
+		// keep the new parse only if it is really smaller
+		TUint64 best=EncodedSize(aEncoding);
+		TEncoding* encoding=new TEncoding();
+		TDeflateTokens parsed;
+		for (TInt pass=0;pass<KDeflateOptimalPasses;++pass)
+		{
+			TDeflateCosts* costs=new TDeflateCosts(aEncoding);
+			AnalyseL(aBuf,aLength,*encoding,parsed,aLevel,costs);
+			delete costs;
+			TUint64 size=EncodedSize(*encoding);
+			if (size>=best)
+				break;
+			best=size;
+			aEncoding=*encoding;
+			tokens.swap(parsed);
+		}
+		delete encoding;
+	}
 
 // generate the required huffman encodings
 	Huffman::HuffmanL(aEncoding.iLitLen,TEncoding::ELitLens,aEncoding.iLitLen);
@@ -466,9 +912,9 @@ void DoDeflateL(const TUint8* aBuf,TInt aLength,TBitOutput& aOutput,TEncoding& a
 	Huffman::Encoding(aEncoding.iLitLen,TEncoding::ELitLens,aEncoding.iLitLen);
 	Huffman::Encoding(aEncoding.iDistance,TEncoding::EDistances,aEncoding.iDistance);
 
-// now finally deflate the data with the generated encoding
+// now finally encode the recorded codes with the generated encoding
 	TDeflater deflater(aOutput,aEncoding);
-	deflater.DeflateL(aBuf,aLength);
+	deflater.ReplayL(tokens);
 	aOutput.PadL(1);
 	}
 
@@ -478,13 +924,14 @@ Function DeflateL
 @param aBuf
 @param aLength
 @param aOutput
+@param aLevel
 @internalComponent
 @released
 */
-void DeflateL(const TUint8* aBuf, TInt aLength, TBitOutput& aOutput)
+void DeflateL(const TUint8* aBuf, TInt aLength, TBitOutput& aOutput, CompressionLevel aLevel)
 	{
 	TEncoding* encoding=new TEncoding();
-	DoDeflateL(aBuf,aLength,aOutput,*encoding);
+	DoDeflateL(aBuf,aLength,aOutput,*encoding,aLevel);
 	delete encoding;
 	}
 /*
@@ -492,15 +939,16 @@ Function DeflateCompress
 @param bytes
 @param size
 @param os
+@param level
 @internalComponent
 @released
 */
-void DeflateCompress(char *bytes,size_t size, std::ofstream & os)
+void DeflateCompress(char *bytes,size_t size, std::ostream & os, CompressionLevel level)
 	{
-	TFileOutput* output=new TFileOutput(os);
-	output->iDataCount = 0;
-	DeflateL((TUint8*)bytes,size,*output);
-	output->FlushL();
-	delete output;
+	// compress into memory and write the whole stream at once
+	std::vector<TUint8> buf(size/2+0x1000);
+	TBufferOutput output(buf);
+	DeflateL((TUint8*)bytes,size,output,level);
+	os.write(reinterpret_cast<char *>(buf.data()),output.Size());
 	}
 
@@ -0,0 +1,429 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Implementation of the Class DsoIndex for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#include <map>
+#include <mutex>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <sys/stat.h>
+
+#include "elfdefs.h"
+#include "checksum.h"
+#include "dsoindex.h"
+#include "errorhandler.h"
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+
+static const char KDsoIndexMagic[4] = {'E', '2', 'D', 'I'};
+static const uint32_t KDsoIndexVersion = 1;
+
+/** Cached index together with the file state it was built from */
+struct DsoCacheEntry
+{
+    int64_t iModified = 0;
+    uint64_t iSize = 0;
+    shared_ptr<const DsoIndex> iIndex;
+};
+
+static string& CacheDir()
+{
+    static string iDir;
+    return iDir;
+}
+
+static uint32_t NameHash(const char* aName, size_t aLength)
+{
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < aLength; i++)
+        h = (h ^ (uint8_t)aName[i]) * 16777619u;
+    return h;
+}
+
+static bool ReadFile(const string& aName, vector<char>& aData)
+{
+    std::ifstream fs(aName.c_str(), std::ifstream::binary);
+    if(!fs)
+        return false;
+    fs.seekg(0, fs.end);
+    std::streamoff size = fs.tellg();
+    if(size < 0)
+        return false;
+    fs.seekg(0, fs.beg);
+    aData.resize((size_t)size);
+    return size == 0 || fs.read(aData.data(), size);
+}
+
+/**
+Function returns the name of the cache file of the DSO: its file name, to
+keep the directory readable, and a hash of the full path, so equally named
+DSOs from different SDKs don't share an entry.
+@internalComponent
+@released
+*/
+static string CacheFile(const string& aDso)
+{
+    size_t pos = aDso.find_last_of("/\\");
+    string name = (pos == string::npos) ? aDso : aDso.substr(pos + 1);
+    char hash[16];
+    snprintf(hash, sizeof(hash), ".%08x.ord", Crc32(aDso.data(), aDso.size()));
+    string dir = CacheDir();
+    if(dir.back() != '/' && dir.back() != '\\')
+        dir.push_back('/');
+    return dir + name + hash;
+}
+
+/**
+Function sets the directory for the on-disk index cache, empty to disable it.
+@param aDir - cache directory, must exist
+@internalComponent
+@released
+*/
+void DsoIndex::SetCacheDir(const string& aDir)
+{
+    CacheDir() = aDir;
+}
+
+/**
+Function returns the index of the DSO, building it on first use. An index is
+rebuilt if the file was modified since. Safe to call from several threads.
+
+With a cache directory, the index is loaded from there if it was built for a
+DSO of the same size and modification time, or of the same size and contents
+so that copied or touched SDKs still hit the cache. Otherwise the new index
+is stored there for the next run.
+@param aDso - path to the DSO
+@return index of the DSO
+@internalComponent
+@released
+*/
+shared_ptr<const DsoIndex> DsoIndex::Get(const string& aDso)
+{
+    static std::mutex lock;
+    static std::map<string, DsoCacheEntry> cache;
+
+    struct stat st;
+    if(stat(aDso.c_str(), &st) != 0)
+        throw Elf2e32Error(FILEOPENERROR, aDso);
+    uint64_t size = st.st_size;
+    int64_t modified = st.st_mtime;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = cache.find(aDso);
+        if(it != cache.end() && it->second.iModified == modified && it->second.iSize == size)
+            return it->second.iIndex;
+    }
+
+    // parse outside the lock, two threads racing for the same DSO build equal indexes
+    string cacheFile = CacheDir().empty() ? string() : CacheFile(aDso);
+    shared_ptr<DsoIndex> index = cacheFile.empty() ? nullptr : Load(cacheFile);
+    if(index && (index->Header()->iSize != size || index->Header()->iModified != modified))
+    {
+        vector<char> file;
+        if(!ReadFile(aDso, file))
+            throw Elf2e32Error(FILEREADERROR, aDso);
+        uint32_t crc = Crc32(file.data(), file.size());
+        if(index->Header()->iSize == size && index->Header()->iCrc == crc)
+            ((DsoIndexHeader*)index->iTable.data())->iModified = modified;
+        else
+            index = Build(aDso, file, crc, modified);
+        index->Store(cacheFile);
+    }
+    else if(!index)
+    {
+        vector<char> file;
+        if(!ReadFile(aDso, file))
+            throw Elf2e32Error(FILEREADERROR, aDso);
+        uint32_t crc = cacheFile.empty() ? 0 : Crc32(file.data(), file.size());
+        index = Build(aDso, file, crc, modified);
+        if(!cacheFile.empty())
+            index->Store(cacheFile);
+    }
+
+    DsoCacheEntry entry;
+    entry.iModified = modified;
+    entry.iSize = size;
+    entry.iIndex = index;
+
+    std::lock_guard<std::mutex> guard(lock);
+    cache[aDso] = entry;
+    return entry.iIndex;
+}
+
+/**
+Function to get symbol ordinal, matches ElfImage::GetSymbolOrdinal()
+@param aSymbol - Symbol name
+@return Symbol ordinal or (PLUINT32)-1 if the DSO doesn't export the symbol
+@internalComponent
+@released
+*/
+PLUINT32 DsoIndex::Ordinal(const char* aSymbol) const
+{
+    if(!aSymbol)
+        return (PLUINT32)-1;
+    size_t len = strlen(aSymbol);
+    uint32_t hash = NameHash(aSymbol, len);
+    const DsoIndexEntry* begin = Entries();
+    const DsoIndexEntry* end = begin + Header()->iCount;
+    const DsoIndexEntry* e = std::lower_bound(begin, end, hash,
+        [](const DsoIndexEntry& aEntry, uint32_t aHash) { return aEntry.iHash < aHash; });
+    for(; e < end && e->iHash == hash; e++)
+    {
+        if(e->iLength == len && !memcmp(Names() + e->iName, aSymbol, len))
+            return e->iOrdinal;
+    }
+    return (PLUINT32)-1;
+}
+
+/**
+Function returns the number of symbols with ordinals
+@internalComponent
+@released
+*/
+size_t DsoIndex::Size() const
+{
+    return Header()->iCount;
+}
+
+const DsoIndexHeader* DsoIndex::Header() const
+{
+    return (const DsoIndexHeader*)iTable.data();
+}
+
+const DsoIndexEntry* DsoIndex::Entries() const
+{
+    return (const DsoIndexEntry*)(iTable.data() + sizeof(DsoIndexHeader));
+}
+
+const char* DsoIndex::Names() const
+{
+    return (const char*)(Entries() + Header()->iCount);
+}
+
+/**
+Function checks that a table read from the cache is complete and consistent
+@internalComponent
+@released
+*/
+bool DsoIndex::Valid() const
+{
+    if(iTable.size() < sizeof(DsoIndexHeader))
+        return false;
+    const DsoIndexHeader* h = Header();
+    if(memcmp(h->iMagic, KDsoIndexMagic, sizeof(KDsoIndexMagic)) || h->iVersion != KDsoIndexVersion)
+        return false;
+    size_t entries = iTable.size() - sizeof(DsoIndexHeader);
+    if(h->iCount > entries / sizeof(DsoIndexEntry))
+        return false;
+    size_t names = entries - h->iCount * sizeof(DsoIndexEntry);
+    const DsoIndexEntry* e = Entries();
+    for(uint32_t i = 0; i < h->iCount; i++)
+    {
+        if(e[i].iName > names || e[i].iLength > names - e[i].iName)
+            return false;
+        if(i && e[i].iHash < e[i - 1].iHash)
+            return false;
+    }
+    return true;
+}
+
+template <class T> static const T* EntryAt(const vector<char>& aFile, size_t aOffset, size_t aCount = 1)
+{
+    if(aOffset > aFile.size() || aCount > (aFile.size() - aOffset) / sizeof(T))
+        return nullptr;
+    return (const T*)(aFile.data() + aOffset);
+}
+
+/**
+Function reads the ordinals of all symbols defined in the code segment and
+lays them out as a flat table. Like ElfImage, it treats the addresses in the
+dynamic table as file offsets.
+@param aDso - path to the DSO, for error messages
+@param aFile - contents of the DSO
+@param aCrc - Crc32() of the contents
+@param aModified - modification time of the DSO
+@return the index
+@internalComponent
+@released
+*/
+shared_ptr<DsoIndex> DsoIndex::Build(const string& aDso, const vector<char>& aFile,
+    uint32_t aCrc, int64_t aModified)
+{
+    const Elf32_Ehdr* ehdr = EntryAt<Elf32_Ehdr>(aFile, 0);
+    if(!ehdr || ehdr->e_ident[EI_MAG0] != ELFMAG0 || ehdr->e_ident[EI_MAG1] != ELFMAG1 ||
+       ehdr->e_ident[EI_MAG2] != ELFMAG2 || ehdr->e_ident[EI_MAG3] != ELFMAG3)
+        throw Elf2e32Error(ELFMAGICERROR, aDso);
+    if(ehdr->e_ident[EI_CLASS] != ELFCLASS32)
+        throw Elf2e32Error(ELFCLASSERROR, aDso);
+
+    const Elf32_Phdr* phdr = EntryAt<Elf32_Phdr>(aFile, ehdr->e_phoff, ehdr->e_phnum);
+    if(!phdr)
+        throw Elf2e32Error(ELFFILEERROR, aDso);
+
+    const Elf32_Phdr* dynamic = nullptr;
+    const Elf32_Phdr* code = nullptr;
+    for(PLUINT32 i = 0; i < ehdr->e_phnum; i++)
+    {
+        if(phdr[i].p_type == PT_DYNAMIC)
+            dynamic = &phdr[i];
+        else if(phdr[i].p_type == PT_LOAD && (phdr[i].p_flags & (PF_X | PF_ARM_ENTRY)))
+            code = &phdr[i];
+    }
+
+    const Elf32_HashTable* hash = nullptr;
+    Elf32_Word strTab = 0, symTab = 0;
+    for(size_t off = dynamic ? dynamic->p_offset : 0; dynamic && code; off += sizeof(Elf32_Dyn))
+    {
+        const Elf32_Dyn* dyn = EntryAt<Elf32_Dyn>(aFile, off);
+        if(!dyn)
+            throw Elf2e32Error(ELFFILEERROR, aDso);
+        if(dyn->d_tag == DT_NULL)
+            break;
+        if(dyn->d_tag == DT_HASH)
+            hash = EntryAt<Elf32_HashTable>(aFile, dyn->d_val);
+        else if(dyn->d_tag == DT_STRTAB)
+            strTab = dyn->d_val;
+        else if(dyn->d_tag == DT_SYMTAB)
+            symTab = dyn->d_val;
+    }
+    if(dynamic && code && (!hash || !strTab || !symTab))
+        throw Elf2e32Error(ELFFILEERROR, aDso);
+
+    PLUINT32 nSyms = hash ? hash->nChains : 0;
+    const Elf32_Sym* syms = EntryAt<Elf32_Sym>(aFile, symTab, nSyms);
+    if(nSyms && (!syms || strTab >= aFile.size()))
+        throw Elf2e32Error(ELFFILEERROR, aDso);
+
+    vector<DsoIndexEntry> entries;
+    entries.reserve(nSyms);
+    for(PLUINT32 i = 1; i < nSyms; i++)
+    {
+        const Elf32_Sym& sym = syms[i];
+        if(sym.st_shndx != ESegmentRO || sym.st_name >= aFile.size() - strTab)
+            continue;
+        const Elf32_Word* ordinal = EntryAt<Elf32_Word>(aFile,
+            code->p_offset + sym.st_value - code->p_vaddr);
+        if(!ordinal)
+            throw Elf2e32Error(ELFFILEERROR, aDso);
+
+        DsoIndexEntry e;
+        const char* name = aFile.data() + strTab + sym.st_name;
+        e.iName = strTab + sym.st_name;
+        e.iLength = strnlen(name, aFile.size() - e.iName);
+        e.iHash = NameHash(name, e.iLength);
+        memcpy(&e.iOrdinal, ordinal, sizeof(e.iOrdinal));
+        entries.push_back(e);
+    }
+
+    // iName is an offset into aFile until the names are copied into the table
+    auto less = [&aFile](const DsoIndexEntry& a, const DsoIndexEntry& b) {
+        if(a.iHash != b.iHash)
+            return a.iHash < b.iHash;
+        return string(aFile.data() + a.iName, a.iLength) < string(aFile.data() + b.iName, b.iLength);
+    };
+    std::stable_sort(entries.begin(), entries.end(), less);
+    entries.erase(std::unique(entries.begin(), entries.end(),
+        [&less](const DsoIndexEntry& a, const DsoIndexEntry& b) { return !less(a, b) && !less(b, a); }),
+        entries.end());
+
+    shared_ptr<DsoIndex> index(new DsoIndex());
+    DsoIndexHeader h;
+    memcpy(h.iMagic, KDsoIndexMagic, sizeof(KDsoIndexMagic));
+    h.iVersion = KDsoIndexVersion;
+    h.iCount = entries.size();
+    h.iCrc = aCrc;
+    h.iSize = aFile.size();
+    h.iModified = aModified;
+
+    size_t namesSize = 0;
+    for(const DsoIndexEntry& e: entries)
+        namesSize += e.iLength;
+    vector<char>& table = index->iTable;
+    table.resize(sizeof(DsoIndexHeader) + entries.size() * sizeof(DsoIndexEntry) + namesSize);
+    memcpy(table.data(), &h, sizeof(h));
+    DsoIndexEntry* out = (DsoIndexEntry*)(table.data() + sizeof(DsoIndexHeader));
+    char* names = (char*)(out + entries.size());
+    uint32_t offset = 0;
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        out[i] = entries[i];
+        out[i].iName = offset;
+        memcpy(names + offset, aFile.data() + entries[i].iName, entries[i].iLength);
+        offset += entries[i].iLength;
+    }
+    return index;
+}
+
+/**
+Function reads an index from the cache
+@param aCacheFile - cache file
+@return the index or nullptr if the file is missing or damaged
+@internalComponent
+@released
+*/
+shared_ptr<DsoIndex> DsoIndex::Load(const string& aCacheFile)
+{
+    shared_ptr<DsoIndex> index(new DsoIndex());
+    if(!ReadFile(aCacheFile, index->iTable) || !index->Valid())
+        return nullptr;
+    return index;
+}
+
+/**
+Function writes the index to the cache. Readers never lock the cache: the
+table is written to a unique temporary file which is then renamed over the
+cache file, so a reader sees either the old or the new table, never a part.
+Failures are ignored, the cache only saves time.
+@param aCacheFile - cache file
+@internalComponent
+@released
+*/
+void DsoIndex::Store(const string& aCacheFile) const
+{
+    std::random_device rd;
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", rd(), rd());
+    string tmp = aCacheFile + suffix;
+    {
+        std::ofstream os(tmp.c_str(), std::ofstream::binary | std::ofstream::trunc);
+        if(!os)
+            return;
+        os.write(iTable.data(), iTable.size());
+        if(!os)
+        {
+            os.close();
+            remove(tmp.c_str());
+            return;
+        }
+    }
+    // rename() replaces an existing file atomically on POSIX. On Windows it
+    // fails if the file exists, so the stale file is removed first and a
+    // reader racing with that just misses the cache.
+    if(rename(tmp.c_str(), aCacheFile.c_str()) != 0)
+    {
+        remove(aCacheFile.c_str());
+        if(rename(tmp.c_str(), aCacheFile.c_str()) != 0)
+            remove(tmp.c_str());
+    }
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Class DsoIndex maps the symbols of an import library to ordinals for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#ifndef DSOINDEX_H
+#define DSOINDEX_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "pl_common.h"
+
+/**
+Header of the flat ordinal table. The table is position independent: the
+header is followed by iCount DsoIndexEntry sorted by hash and name, then by
+the symbol names. Kept in memory as is and stored as is in the --dsocache
+directory.
+@internalComponent
+@released
+*/
+struct DsoIndexHeader
+{
+    char iMagic[4];
+    uint32_t iVersion;
+    uint32_t iCount;
+    /** Crc32() of the DSO the table was built from */
+    uint32_t iCrc;
+    uint64_t iSize;
+    int64_t iModified;
+};
+
+/**
+Entry of the flat ordinal table, iName is offset of the name from the end
+of the entries.
+@internalComponent
+@released
+*/
+struct DsoIndexEntry
+{
+    uint32_t iHash;
+    uint32_t iName;
+    uint32_t iLength;
+    uint32_t iOrdinal;
+};
+
+/**
+Symbol name to ordinal table of an import library (DSO).
+Only the dynamic symbol table and the ordinals in the code segment are read,
+so it is much cheaper than a full ElfImage. Get() keeps one index per file
+for the whole process and, with SetCacheDir(), shares the indexes between
+processes through files in the cache directory.
+@internalComponent
+@released
+*/
+class DsoIndex
+{
+    public:
+        static std::shared_ptr<const DsoIndex> Get(const std::string& aDso);
+        static void SetCacheDir(const std::string& aDir);
+
+        PLUINT32 Ordinal(const char* aSymbol) const;
+        size_t Size() const;
+    private:
+        DsoIndex() = default;
+
+        static std::shared_ptr<DsoIndex> Build(const std::string& aDso,
+            const std::vector<char>& aFile, uint32_t aCrc, int64_t aModified);
+        static std::shared_ptr<DsoIndex> Load(const std::string& aCacheFile);
+        void Store(const std::string& aCacheFile) const;
+
+        const DsoIndexHeader* Header() const;
+        const DsoIndexEntry* Entries() const;
+        const char* Names() const;
+        bool Valid() const;
+    private:
+        std::vector<char> iTable;
+};
+
+#endif // DSOINDEX_H
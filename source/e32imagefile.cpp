@@ -30,32 +30,36 @@
     #include <io.h>
 #endif
 #include <time.h>
-#include <stdio.h>
+#include <stdio.h>
 
-#include "h_ver.h"
+#include "h_ver.h"
 #include "e32flags.h"
 #include "checksum.h"
-#include "pl_elfimage.h"
+#include "dsoindex.h"
+#include "libpathindex.h"
+#include "pl_elfimage.h"
 #include "pl_symbol.h"
 #include "e32imagefile.h"
 #include "errorhandler.h"
 #include "pl_elfimports.h"
 #include "elffilesupplied.h"
 #include "parametermanager.h"
+#include "pagedcompress.h"
+#include "workerpool.h"
 #include "pl_elflocalrelocation.h"
 
-using namespace std;
-
-struct E32RelocPageDesc {
-    uint32_t aOffset;
-    uint32_t aSize;
-};
-
-void CreateRelocations(ElfRelocations::Relocations & aRelocations, char * & aRelocs, size_t & aRelocsSize);
-size_t RelocationsSize(ElfRelocations::Relocations & aRelocs);
+using namespace std;
+
+struct E32RelocPageDesc {
+    uint32_t aOffset;
+    uint32_t aSize;
+};
+
+void CreateRelocations(ElfRelocations::Relocations & aRelocations, char * & aRelocs, size_t & aRelocsSize);
+size_t RelocationsSize(ElfRelocations::Relocations & aRelocs);
 uint16 GetE32RelocType(ElfRelocation * aReloc);
 
-template <class T>
+template <class T>
 inline T Align(T v, size_t s)
 {
 	unsigned int inc = s-1;
@@ -121,7 +125,7 @@ This function creates and adds a chunk into a list.
 void E32ImageChunks::AddChunk(const char * aData, size_t aSize, size_t aOffset, const char * aDoc)
 {
 	E32ImageChunkDesc * aChunk = new E32ImageChunkDesc(aData, aSize, aOffset, aDoc);
-	iChunks.push_back(aChunk);
+	iChunks.push_back(aChunk);
 	iOffset += Align(aSize, sizeof(TUint32));
 }
 
@@ -158,47 +162,47 @@ void E32ImageChunks::SetOffset(size_t aOffset)
 }
 
 void E32ImageChunks::SectionsInfo()
-{
-    for(auto x: iChunks)
-    {
-        printf("Added Chunks has size: %06zx for section: %s at address: %08zx\n", x->iSize, x->iDoc, x->iOffset);
+{
+    for(auto x: iChunks)
+    {
+        printf("Added Chunks has size: %06zx for section: %s at address: %08zx\n", x->iSize, x->iDoc, x->iOffset);
     }
 }
-
-/** @brief Disasm section content
-If lenth > 0 prints specified section size
-*/
-void E32ImageChunks::DisasmChunk(uint16_t index, uint32_t length, uint32_t pos)
-{
-    E32ImageChunkDesc *tmp = iChunks[index];
-    if(!length) length = tmp->iSize;
-    printf("Disassembled section: %s at addr: %08zx\n",tmp->iDoc, tmp->iOffset+pos);
-    printf("Has data:\n");
-    for(uint32_t i = 0, sep = 0; i < length; i++, sep++)
-    {
-        size_t k = *(uint8_t *)(tmp->iData + i + pos);
-
-        printf("%02zx", k);
-        if(sep == 16)
-        {
-            sep = 0;
-            cout << "\n";
-        }
-        if((sep == 4)||(sep == 8)||(sep == 12)) cout << "   ";
-    }
+
+/** @brief Disasm section content
+If lenth > 0 prints specified section size
+*/
+void E32ImageChunks::DisasmChunk(uint16_t index, uint32_t length, uint32_t pos)
+{
+    E32ImageChunkDesc *tmp = iChunks[index];
+    if(!length) length = tmp->iSize;
+    printf("Disassembled section: %s at addr: %08zx\n",tmp->iDoc, tmp->iOffset+pos);
+    printf("Has data:\n");
+    for(uint32_t i = 0, sep = 0; i < length; i++, sep++)
+    {
+        size_t k = *(uint8_t *)(tmp->iData + i + pos);
+
+        printf("%02zx", k);
+        if(sep == 16)
+        {
+            sep = 0;
+            cout << "\n";
+        }
+        if((sep == 4)||(sep == 8)||(sep == 12)) cout << "   ";
+    }
 }
 /**
 Constructor for E32ImageFile class.
 @internalComponent
 @released
 */
-E32ImageFile::E32ImageFile(ElfImage * aElfImage = nullptr, ElfFileSupplied *aUseCase = nullptr,
+E32ImageFile::E32ImageFile(ElfImage * aElfImage = nullptr, ElfFileSupplied *aUseCase = nullptr,
            ParameterManager * aManager = nullptr, E32ExportTable *aTable = nullptr) :
 	iElfImage(aElfImage),
-	iUseCase(aUseCase),
-	iManager(aManager),
-	iTable(aTable)
-	{}
+	iUseCase(aUseCase),
+	iManager(aManager),
+	iTable(aTable)
+	{}
 
 /**
 This function generates the E32 image.
@@ -212,28 +216,28 @@ void E32ImageFile::GenerateE32Image()
 	}
 	ProcessImports();
 	ProcessRelocations();
-	ConstructImage();
+	ConstructImage();
 	//PrintAddrInfo(0x58);
 }
-
-void E32ImageFile::PrintAddrInfo(uint32_t addr)
-{
-    if(addr < iHdr->iCodeOffset)
-    {
-        if(addr < sizeof(E32ImageHeader))
-        {
-            cout << "That address belongs to ";
-            if( offsetof(class E32ImageHeader, iExportDirOffset) == addr)
-                cout << "E32ImageHeader.iExportDirOffset.\n";
-        }
-        else if( (addr > sizeof(E32ImageHeader)) && (addr <
-                        (sizeof(E32ImageHeader) + sizeof(E32ImageHeaderComp))) )
-            cout << "That address placed in E32ImageHeaderComp Section\n";
-        else
-            cout << "That address placed in E32ImageHeaderV Section\n";
-    }
-}
-
+
+void E32ImageFile::PrintAddrInfo(uint32_t addr)
+{
+    if(addr < iHdr->iCodeOffset)
+    {
+        if(addr < sizeof(E32ImageHeader))
+        {
+            cout << "That address belongs to ";
+            if( offsetof(class E32ImageHeader, iExportDirOffset) == addr)
+                cout << "E32ImageHeader.iExportDirOffset.\n";
+        }
+        else if( (addr > sizeof(E32ImageHeader)) && (addr <
+                        (sizeof(E32ImageHeader) + sizeof(E32ImageHeaderComp))) )
+            cout << "That address placed in E32ImageHeaderComp Section\n";
+        else
+            cout << "That address placed in E32ImageHeaderV Section\n";
+    }
+}
+
 
 /**
 This function processes the import map by looking into the dso files
@@ -250,19 +254,17 @@ void E32ImageFile::ProcessImports()
 	int numImports = 0;
 	bool namedLookup = iManager->SymNamedLookup();
 
-	ElfImports::ImportLibs importLibs = iElfImage->GetImports();
+	const ElfImports::ImportLibs& importLibs = iElfImage->GetImports();
 
 	// First set up the string table and record offsets into string table of each
 	// LinkAs name.
-	for (auto p: importLibs)
+	for (const auto& relocs: importLibs)
 	{
-		ElfImports::RelocationList & relocs = p.second;
 		char* aLinkAs = relocs[0]->iVerRecord->iLinkAs;
 
 		strTabOffsets.push_back(strTab.size()); //
-		string s = aLinkAs;
-		strTab.insert(strTab.end(),s.begin(),s.end());
-		strTab.insert(strTab.end(),0);
+		strTab.append(aLinkAs);
+		strTab.push_back(0);
 		numDlls++;
 		numImports += relocs.size();
 	}
@@ -276,6 +278,7 @@ void E32ImageFile::ProcessImports()
             (sizeof(uint32_t) * numImports);
 
 	vector<Elf32_Word> aImportSection;
+	aImportSection.reserve(importSectionSize / sizeof(Elf32_Word) + numDlls);
 
 	// This is the 'E32ImportSection' header - fill with 0 for the moment
 	aImportSection.push_back(0); // E32ImportSection::iSize = 0
@@ -285,15 +288,21 @@ void E32ImageFile::ProcessImports()
 		// entry for each DLL.
 		importSectionSize += (sizeof(uint32_t) * numDlls);
 	}
+	// Resolve the ordinals of every DSO on the workers. An error found there is
+	// raised below when its DSO is reached, as if the DSOs were processed in turn.
+	vector<ResolvedImports> resolved(importLibs.size());
+	WorkerPool::GetInstance()->ParallelFor(importLibs.size(), [&](size_t aLib, size_t)
+	{
+		ResolveImports(importLibs[aLib], resolved[aLib]);
+	});
+
 	// Now fill in the E32ImportBlocks
 	int idx = 0;
-	for (auto p: importLibs)
+	for (const auto& imports: importLibs)
 	{
-		ElfImports::RelocationList & imports = p.second;
-		string dsoName = imports[0]->iVerRecord->iSOName;
-
-		//const char * aDSO = FindDSO((*p).first);
-		string aDSO = FindDSO(dsoName);
+		const ResolvedImports& aResolved = resolved[idx];
+		if (aResolved.iError)
+			std::rethrow_exception(aResolved.iError);
 
 		aImportSection.push_back(strTabOffsets[idx] + importSectionSize);
 		int nImports = imports.size();
@@ -303,33 +312,31 @@ void E32ImageFile::ProcessImports()
 
 		aImportSection.push_back(nImports);
 
-		ElfImage aElfImage(aDSO);
-		aElfImage.ProcessElfFile();
-
-		for(auto aReloc: imports)
+		for(size_t i = 0; i < imports.size(); i++)
 		{
-			char * aSymName = iElfImage->GetSymbolName(aReloc->iSymNdx);
-			unsigned int aOrdinal = aElfImage.GetSymbolOrdinal(aSymName);
-
+			ElfRelocation *aReloc = imports[i];
 			//check the reloc refers to Code Segment
-			try
-			{
-				if (iElfImage->SegmentType(aReloc->iAddr) != ESegmentRO)
-					throw Elf2e32Error(ILLEGALEXPORTFROMDATASEGMENT, aSymName, iElfImage->iElfInput);
-			}
-			/**This catch block introduced here is to avoid deleting partially constructed object(s).
-			Otherwise global catch block will delete the partially constructed object(s) and the tool will crash.
-			*/
-			catch(ErrorHandler& aError)
+			if (i == aResolved.iOrdinals.size())
 			{
-				aError.Report();
-				exit(EXIT_FAILURE);
+				/**This catch block introduced here is to avoid deleting partially constructed object(s).
+				Otherwise global catch block will delete the partially constructed object(s) and the tool will crash.
+				*/
+				try
+				{
+					std::rethrow_exception(aResolved.iRelocError);
+				}
+				catch(ErrorHandler& aError)
+				{
+					aError.Report();
+					exit(EXIT_FAILURE);
+				}
 			}
+			unsigned int aOrdinal = aResolved.iOrdinals[i];
 
 			Elf32_Word aRelocOffset = iElfImage->GetRelocationOffset(aReloc);
 			aImportSection.push_back(aRelocOffset);
 
-			Elf32_Word * aRelocPlace = iElfImage->GetRelocationPlace(aReloc);
+			Elf32_Word * aRelocPlace = iElfImage->GetRelocationPlace(aReloc);
 //todo: wtf??:: empty conditions???
 			if (aOrdinal > 0xFFFF)
 			{
@@ -346,13 +353,13 @@ void E32ImageFile::ProcessImports()
 			iImportTabLocations.push_back(aImportTabEntryPos);
 			// Put the entry as 0 now, which shall be updated
 			aImportSection.push_back(0);
-		}
+		}
 		idx++;
 	}
 
 	assert(importSectionSize == aImportSection.size() * sizeof(Elf32_Word));
 
-	size_t totalSize = Align(importSectionSize + strTab.size(), sizeof(Elf32_Word));
+	size_t totalSize = Align(importSectionSize + strTab.size(), sizeof(Elf32_Word));
 
 	// Fill in the section header now we have the correct value.
 	aImportSection[0] = totalSize;
@@ -366,6 +373,48 @@ void E32ImageFile::ProcessImports()
 }
 
 
+/**
+This function finds the DSO of the imports and the ordinals of the imported
+symbols. It only reads shared data so several DSOs may be resolved at once.
+Errors are stored in aResolved: iError for a missing or broken DSO,
+iRelocError for the first import not from the code segment, where
+iOrdinals stops.
+@param aImports - relocations importing from the DSO
+@param aResolved - ordinal for every relocation
+@internalComponent
+@released
+*/
+void E32ImageFile::ResolveImports(const ElfImports::ImportLib& aImports, ResolvedImports& aResolved)
+{
+	try
+	{
+		string aDSO = FindDSO(aImports[0]->iVerRecord->iSOName);
+		std::shared_ptr<const DsoIndex> aDsoIndex = DsoIndex::Get(aDSO);
+
+		aResolved.iOrdinals.reserve(aImports.size());
+		for(auto aReloc: aImports)
+		{
+			char * aSymName = iElfImage->GetSymbolName(aReloc->iSymNdx);
+			unsigned int aOrdinal = aDsoIndex->Ordinal(aSymName);
+			try
+			{
+				if (iElfImage->SegmentType(aReloc->iAddr) != ESegmentRO)
+					throw Elf2e32Error(ILLEGALEXPORTFROMDATASEGMENT, aSymName, iElfImage->iElfInput);
+			}
+			catch(ErrorHandler&)
+			{
+				aResolved.iRelocError = std::current_exception();
+				return;
+			}
+			aResolved.iOrdinals.push_back(aOrdinal);
+		}
+	}
+	catch(...)
+	{
+		aResolved.iError = std::current_exception();
+	}
+}
+
 /**
 This function checks if a DSO file exists.
 @param aPath - DSO file name.
@@ -374,14 +423,16 @@ This function checks if a DSO file exists.
 */
 bool ProbePath(string & aPath)
 {
-	fstream input(aPath);
+	fstream input(aPath);
 	bool r = input.is_open();
-    input.close();
+    input.close();
     return r;
 }
 
 /**
 This function searches for a DSO in the libpath specified.
+The libpath directories are listed once by LibPathIndex instead of probing
+each of them for every DSO.
 @param aName - DSO file name
 @internalComponent
 @released
@@ -395,12 +446,22 @@ string E32ImageFile::FindDSO(string aName)
 		return aDSOName;
 
 	ParameterManager::LibSearchPaths & paths = iManager->LibPath();
+	string dir = LibPathIndex::GetInstance()->Find(paths, aDSOName);
+	if (!dir.empty())
+	{
+		aDSOPath = dir + directoryseparator + aDSOName;
+		if (ProbePath(aDSOPath))
+			return aDSOPath;
+	}
+
+	// not in the listings (e.g. a name with a directory part or another
+	// letter case on a case-insensitive file system), probe as is
 	for (auto x: paths)
 	{
 		string path(x);
 		aDSOPath.erase();
-		aDSOPath.insert(aDSOPath.end(), path.begin(), path.end());
-		aDSOPath.insert(aDSOPath.end(), directoryseparator);
+		aDSOPath.insert(aDSOPath.end(), path.begin(), path.end());
+		aDSOPath.insert(aDSOPath.end(), directoryseparator);
 		aDSOPath.insert(aDSOPath.end(), aDSOName.begin(), aDSOName.end());
 		if (ProbePath(aDSOPath))
 		{
@@ -416,7 +477,7 @@ This function processes Code and Data relocations.
 @released
 */
 void E32ImageFile::ProcessRelocations()
-{
+{
 	CreateRelocations(iElfImage->GetCodeRelocations(), iCodeRelocs, iCodeRelocsSize);
 	CreateRelocations(iElfImage->GetDataRelocations(), iDataRelocs, iDataRelocsSize);
 }
@@ -490,7 +551,7 @@ sorted.
 size_t RelocationsSize(ElfRelocations::Relocations & relocs)
 {
 	size_t bytecount = 0;
-	int page = -1;
+	int page = -1;
 	for(auto x: relocs)
 	{
 		int p = x->iAddr & 0xfffff000;
@@ -596,7 +657,7 @@ This function initialises the E32 image header fields.
 */
 void E32ImageFile::InitE32ImageHeader()
 {
-	iHdr = iUseCase->AllocateE32ImageHeader();
+	iHdr = iUseCase->AllocateE32ImageHeader();
 	E32Flags *flg = new E32Flags(iManager);
 
 	iHdr->iUid1 = 0;
@@ -609,7 +670,7 @@ void E32ImageFile::InitE32ImageHeader()
 	iHdr->iToolsVersion = TVersion(MajorVersion, MinorVersion, Build);
 	Int64 ltime = timeToInt64(time(nullptr));
 	iHdr->iTimeLo=(uint32)ltime;
-	iHdr->iTimeHi=(uint32)(ltime>>32);
+	iHdr->iTimeHi=(uint32)(ltime>>32);
 	iHdr->iFlags=flg->Run();
 	// Confusingly, CodeSize means everything except writable data
 	iHdr->iCodeSize = 0;
@@ -639,13 +700,13 @@ void E32ImageFile::InitE32ImageHeader()
 
 	iHdr->iExportDescSize = iUseCase->GetExportDescSize();
 	iHdr->iExportDescType = iUseCase->GetExportDescType();
-	if (iHdr->iExportDescSize == 0) iHdr->iExportDesc[0] = 0;
-
+	if (iHdr->iExportDescSize == 0) iHdr->iExportDesc[0] = 0;
+
 	delete flg;
 }
 
 /**
-This function creates the E32 image layout.
+This function creates the E32 image layout.
 Insert call to E32ImageChunks::DisasmChunk() here if see content nedeed
 @internalComponent
 @released
@@ -671,9 +732,9 @@ void E32ImageFile::ComputeE32ImageLayout()
 	//	b. symbol lookup is enabled - because this table also indicates the dependencies
 	bool aExportTableNeeded = (iHdr->iExportDirCount || aSymLkupEnabled) ? 1 : 0;
 
-	if ( aExportTableNeeded && iTable->AllocateP()){
+	if ( aExportTableNeeded && iTable->AllocateP()){
         iHdr->iExportDirOffset = iChunks.GetOffset() + 4;
-		iChunks.AddChunk((char *)iTable->GetExportTable(),
+		iChunks.AddChunk((char *)iTable->GetExportTable(),
                 iTable->GetExportTableSize(), iChunks.GetOffset(), "Export Table");
     }
 
@@ -686,13 +747,13 @@ void E32ImageFile::ComputeE32ImageLayout()
 
 	// CodeSize is current offset - endof header offset
 	iHdr->iTextSize = iHdr->iCodeSize = iChunks.GetOffset() - endOfHeader;
-
+
 	// Data section
 	if (iElfImage->GetRWSize())
-	{
+	{
 		iHdr->iDataOffset = iChunks.GetOffset();
 		iChunks.AddChunk(iElfImage->GetRawRWSegment(), iElfImage->GetRWSize(), iHdr->iDataOffset, "Data Section");
-	}
+	}
 
 	// Import Section
 	if (iImportSectionSize)
@@ -784,7 +845,7 @@ void E32ImageFile::AddExportDescription()
 
 	iHdr->iExportDescType = edt;
 	if (edt == KImageHdr_ExpD_FullBitmap)
-	{
+	{
 	    assert(memsz > 65536);
 		iHdr->iExportDescSize = memsz;
 		iHdr->iExportDesc[0] = iExportBitMap[0];
@@ -793,7 +854,7 @@ void E32ImageFile::AddExportDescription()
 		iChunks.AddChunk((char *)aDesc,extra_space, iChunks.GetOffset(), "Export Description");
 	}
 	else
-	{
+	{
 	    assert(((mbs + nbytes) > 65536));
 		iHdr->iExportDescSize = mbs + nbytes;
 		uint8 * aBuf = new uint8[extra_space + 1]();
@@ -814,23 +875,23 @@ void E32ImageFile::AddExportDescription()
 		iChunks.AddChunk((char *)aDesc,extra_space, iChunks.GetOffset(), "Export Description");
 	}
 }
-
-bool E32ImageFile::AllowDllData()
-{
-    if(!iManager->HasDllData())
-        return false;
-
-    ETargetType type = iManager->TargetTypeName();
-
-    switch(type)
-    {
-        case EDll: case EPolyDll: case EExe: case EExexp: case EStdExe:
-            return true;
-        default:
-            return false;
-    }
-	return false;
-}
+
+bool E32ImageFile::AllowDllData()
+{
+    if(!iManager->HasDllData())
+        return false;
+
+    ETargetType type = iManager->TargetTypeName();
+
+    switch(type)
+    {
+        case EDll: case EPolyDll: case EExe: case EExexp: case EStdExe:
+            return true;
+        default:
+            return false;
+    }
+	return false;
+}
 
 /**
 This function sets the fields of the E32 image.
@@ -838,7 +899,7 @@ This function sets the fields of the E32 image.
 @released
 */
 void E32ImageFile::SetE32ImgHdrFields()
-{
+{
     E32ImageHeader *tmp = iManager->GetE32Header();
 	// Arrange a header for this E32 Image
 	iHdr->iCpuIdentifier = (uint16)ECpuArmV5;
@@ -846,25 +907,25 @@ void E32ImageFile::SetE32ImgHdrFields()
 	bool isDllp = iUseCase->ImageIsDll();
 	if (isDllp)
 	{
-		iHdr->iFlags |= KImageDll;
-		if(!AllowDllData())
-        {
-            auto z = iElfImage->iExports->GetExports(false);
-
-            for(auto x: z)
-            {
-                if(x->CodeDataType() == SymbolTypeData)
-                {
-                    cout << "Found global symbol(s):\n";
-                    break;
-                }
-            }
-
-            for(auto x: z)
-            {
-                if(x->CodeDataType() == SymbolTypeData)
-                    cout << "\t" << x->SymbolName() << "\n";
-            }
+		iHdr->iFlags |= KImageDll;
+		if(!AllowDllData())
+        {
+            auto z = iElfImage->iExports->GetExports(false);
+
+            for(auto x: z)
+            {
+                if(x->CodeDataType() == SymbolTypeData)
+                {
+                    cout << "Found global symbol(s):\n";
+                    break;
+                }
+            }
+
+            for(auto x: z)
+            {
+                if(x->CodeDataType() == SymbolTypeData)
+                    cout << "\t" << x->SymbolName() << "\n";
+            }
             if (iHdr->iDataSize)
                 throw Elf2e32Error(DLLHASINITIALISEDDATAERROR, iManager->ElfInput());
             if (iHdr->iBssSize)
@@ -887,21 +948,21 @@ void E32ImageFile::SetE32ImgHdrFields()
 		throw Elf2e32Error(ENTRYPOINTNOTSUPPORTEDERROR, iManager->ElfInput());
 
 	SetUpExceptions();
-
+
     iHdr->iUid1=tmp->iUid1;
 	iHdr->iUid2=tmp->iUid2;
-	iHdr->iUid3=tmp->iUid3;
-
+	iHdr->iUid3=tmp->iUid3;
+
 	SSecurityInfo *info = iManager->GetSSecurityInfo();
 	iHdr->iS.iSecureId = info->iSecureId;
-	iHdr->iS.iVendorId = info->iVendorId;
-
-	iHdr->iS.iCaps = iManager->Capability();
+	iHdr->iS.iVendorId = info->iVendorId;
+
+	iHdr->iS.iCaps = iManager->Capability();
 
 	SetPriority(isDllp);
-	SetFixedAddress(isDllp);
+	SetFixedAddress(isDllp);
 
-	iHdr->iModuleVersion = iManager->Version();
+	iHdr->iModuleVersion = iManager->Version();
 	iHdr->iCompressionType = iManager->CompressionMethod();
 	UpdateHeaderCrc();
 }
@@ -1011,10 +1072,10 @@ void E32ImageFile::SetFixedAddress(bool isDllp)
 	else
 		iHdr->iFlags&=~KImageFixedAddressExe;
 }
-
-TUint TE32ImageUids::Check()
-{
-    return ((checkSum(((TUint8*)this)+1)<<16)|checkSum(this));
+
+TUint TE32ImageUids::Check()
+{
+    return ((checkSum(((TUint8*)this)+1)<<16)|checkSum(this));
 }
 /**
 Constructor for TE32ImageUids.
@@ -1076,7 +1137,7 @@ void E32ImageFile::UpdateHeaderCrc()
 This function creates a buffer and writes all the data into the buffer.
 @internalComponent
 @released
-*/
+*/
 int32_t ValidateE32Image(const char *buffer, uint32_t size);
 void E32ImageFile::AllocateE32Image()
 {
@@ -1090,12 +1151,12 @@ void E32ImageFile::AllocateE32Image()
 	}
 
 	E32ImageHeaderV* header = (E32ImageHeaderV*)iE32Image;
-	TInt headerSize = header->TotalSize();
+	TInt headerSize = header->TotalSize();
 	if(KErrNone!=header->ValidateWholeImage(iE32Image+headerSize, imageSize - headerSize))
 		throw Elf2e32Error(VALIDATIONERROR, iManager->E32ImageOutput());
-
-	if( KErrNone!=ValidateE32Image(iE32Image, imageSize) )
-		throw Elf2e32Error(VALIDATIONERROR, iManager->E32ImageOutput());
+
+	if( KErrNone!=ValidateE32Image(iE32Image, imageSize) )
+		throw Elf2e32Error(VALIDATIONERROR, iManager->E32ImageOutput());
 }
 
 /**
@@ -1103,20 +1164,11 @@ This function deflates the compressed data.
 @param bytes
 @param size
 @param os
+@param level
 @internalComponent
 @released
 */
-void DeflateCompress(char* bytes, size_t size, ofstream & os);
-
-/**
-This function Paged Pack the compressed data.
-@param bytes
-@param size
-@param os
-@internalComponent
-@released
-*/
-void CompressPages(TUint8 * bytes, TInt size, ofstream& os);
+void DeflateCompress(char* bytes, size_t size, std::ostream & os, CompressionLevel level);
 
 
 /**
@@ -1133,12 +1185,28 @@ bool E32ImageFile::WriteImage(const char * aName)
 	if (os->is_open())
 	{
 		uint32 compression = iHdr->CompressionType();
-		if (compression == KUidCompressionDeflate)
+		if (iManager->CompressionAuto())
+		{
+			// the header is written once the compression method is chosen
+			size_t aHeaderSize = GetExtendedE32ImageHeaderSize();
+			std::string body;
+			E32ImageHeaderV* header = (E32ImageHeaderV*)iE32Image;
+			header->iCompressionType = CompressBest((TUint8*)iE32Image + aHeaderSize,
+				GetE32ImageSize() - aHeaderSize, iHdr->iCodeSize,
+				iManager->GetCompressionLevel(), iManager->CompressionMargin(), body);
+			header->iHeaderCrc = KImageCrcInitialiser;
+			header->iHeaderCrc = Crc32(header, aHeaderSize);
+			iHdr->iCompressionType = header->iCompressionType;
+			iHdr->iHeaderCrc = header->iHeaderCrc;
+			os->write(iE32Image, aHeaderSize);
+			os->write(body.data(), body.size());
+		}
+		else if (compression == KUidCompressionDeflate)
 		{
 			size_t aHeaderSize = GetExtendedE32ImageHeaderSize();
 			size_t aBodySize = GetE32ImageSize() - aHeaderSize;
 			os->write(iE32Image, aHeaderSize);
-			DeflateCompress(iE32Image + aHeaderSize, aBodySize, *os);
+			DeflateCompress(iE32Image + aHeaderSize, aBodySize, *os, iManager->GetCompressionLevel());
 		}
 		else if (compression == KUidCompressionBytePair)
 		{
@@ -1147,14 +1215,14 @@ bool E32ImageFile::WriteImage(const char * aName)
 
 			// Compress and write out code part
 			int offset = GetExtendedE32ImageHeaderSize();
-			CompressPages( (TUint8*)iE32Image + offset, iHdr->iCodeSize, *os);
+			CompressPages( (TUint8*)iE32Image + offset, iHdr->iCodeSize, *os, iManager->GetCompressionLevel());
 
 
 			// Compress and write out data part
 			offset += iHdr->iCodeSize;
 			int srcLen = GetE32ImageSize() - offset;
 
-			CompressPages((TUint8*)iE32Image + offset, srcLen, *os);
+			CompressPages((TUint8*)iE32Image + offset, srcLen, *os, iManager->GetCompressionLevel());
 
 		}
 		else if (compression == 0)
@@ -1190,18 +1258,16 @@ E32ImageFile::~E32ImageFile()
 	delete [] iImportSection;
 }
 
-int DecompressPages(TUint8 * bytes, ifstream& is);
-
-void E32ImageFile::ProcessSymbolInfo()
+void E32ImageFile::ProcessSymbolInfo()
 {
     Elf32_Addr elfAddr = iTable->iExportTableAddress - 4;// This location points to 0th ord.
 	// Create a relocation entry for the 0th ordinal.
 	ElfLocalRelocation *rel = new ElfLocalRelocation(iElfImage, elfAddr, 0, 0, R_ARM_ABS32,
-		nullptr, ESegmentRO, nullptr, false);
-
+		nullptr, ESegmentRO, nullptr, false);
+
 	iElfImage->AddToLocalRelocations(rel);
 
-	elfAddr += iTable->GetExportTableSize();// aPlace now points to the symInfo
+	elfAddr += iTable->GetExportTableSize();// aPlace now points to the symInfo
 	uint32 *aZerothOrd = iTable->GetExportTable();
 	*aZerothOrd = elfAddr;
 	elfAddr += sizeof(E32EpocExpSymInfoHdr);// aPlace now points to the symbol address
@@ -1212,21 +1278,21 @@ void E32ImageFile::ProcessSymbolInfo()
 	// Donot disturb the internal list sorting.
 	ElfExports::Exports exports = iElfImage->iExports->GetExports(false);
 
-//	std::cout << "aList.size() is: " << aList.size() << "\n";
-
-//	int i = 0;
-//	for(auto x: aList)
-//    {
-//        i++;
-//        if(!x->iElfSym)
-//            std::cout << "ABSENT exported function at pos: " << i << "\n";
+//	std::cout << "aList.size() is: " << aList.size() << "\n";
+
+//	int i = 0;
+//	for(auto x: aList)
+//    {
+//        i++;
+//        if(!x->iElfSym)
+//            std::cout << "ABSENT exported function at pos: " << i << "\n";
 //	}
 
 	const char aPad[] = {'\0', '\0', '\0', '\0'};
-/** TODO (Administrator#1#04/15/17): The nullptr iElfSym position corresponds to the Absent function in def file */
-	for(auto x: exports ) {
-		if(!x->iElfSym) continue;
-
+/** TODO (Administrator#1#04/15/17): The nullptr iElfSym position corresponds to the Absent function in def file */
+	for(auto x: exports ) {
+		if(!x->iElfSym) continue;
+
 		iSymAddrTab.push_back(x->iElfSym->st_value);
 		// The symbol names always start at a 4-byte aligned offset.
 		iSymNameOffset = iSymbolNames.size() >> 2;
@@ -1240,7 +1306,7 @@ void E32ImageFile::ProcessSymbolInfo()
 		if(align % 4){
 			iSymbolNames.append(aPad, align);
 		}
-		//Create a relocation entry...
+		//Create a relocation entry...
 		rel = new ElfLocalRelocation(iElfImage, elfAddr, 0, 0, R_ARM_ABS32, nullptr,
 			ESegmentRO, x->iElfSym, false);
 		elfAddr += sizeof(uint32);
@@ -1248,7 +1314,7 @@ void E32ImageFile::ProcessSymbolInfo()
 	}
 }
 
-char* E32ImageFile::CreateSymbolInfo(size_t aBaseOffset)
+char* E32ImageFile::CreateSymbolInfo(size_t aBaseOffset)
 {
 	E32EpocExpSymInfoHdr aSymInf;
 	uint32 sizeofNames;
@@ -1282,8 +1348,8 @@ char* E32ImageFile::CreateSymbolInfo(size_t aBaseOffset)
 	aPos = aSymInf.iStringTableOffset;
 	memcpy(aInfo+aPos, (void*)&iSymbolNames.at(0), iSymbolNames.size());
 
-    /** TODO (Administrator#5#04/16/17): Unfinished code?!!! */
-
+    /** TODO (Administrator#5#04/16/17): Unfinished code?!!! */
+
 	// At the end, the dependencies are listed. They remain zeroes and shall be fixed up
 	// while relocating.
 
@@ -1293,7 +1359,7 @@ char* E32ImageFile::CreateSymbolInfo(size_t aBaseOffset)
 	uint32 aOffset = aBaseOffset - iHdr->iCodeOffset;// This gives the offset of syminfo table base
 										// wrt the code section start
 	aOffset += aSymInf.iDepDllZeroOrdTableOffset; // This points to the ordinal zero offset table now
-	for(auto x: iImportTabLocations) {
+	for(auto x: iImportTabLocations) {
         printf("offSet: %08x\n", aOffset);
 		uint32 *aLocation = (aImportTab + x);
 		*aLocation = aOffset;
@@ -1321,11 +1387,11 @@ void E32ImageFile::SetSymInfo(E32EpocExpSymInfoHdr& aSymInfo)
 		aSymInfo.iFlags |= 1;//set the 0th bit
 	}
 	symSize += Align((aNSymbols * sizeofNames), sizeof(uint32)); // Symbol name offsets
-	aSymInfo.iStringTableOffset = symSize;
+	aSymInfo.iStringTableOffset = symSize;
 
 	TUint aNameTabSz = iSymbolNames.size();
 	aSymInfo.iStringTableSz = aNameTabSz;
-	symSize += aNameTabSz; // Symbol names in string tab
+	symSize += aNameTabSz; // Symbol names in string tab
 
 	aSymInfo.iDepDllZeroOrdTableOffset = symSize;
 	aSymInfo.iDllCount = iNumDlls ;
@@ -17,14 +17,17 @@
 //
 //
 
+#include <vector>
 #include <fstream>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
 
 #include "message.h"
 #include "e32common.h"
 #include "e32parser.h"
 #include "errorhandler.h"
+#include "pagedcompress.h"
 
 using std::fstream;
 
@@ -102,31 +105,39 @@ E32ImageHeader* E32Parser::GetFileLayout()
     return iHdr;
 }
 
-void InflateUnCompress(unsigned char* source, int sourcesize,unsigned char* dest, int destsize);
-int DecompressPages(uint8_t* bytes, std::ifstream& is);
+int InflateUnCompress(unsigned char* source, int sourcesize,unsigned char* dest, int destsize);
+int InflateStream(std::istream& aStream, int aSize, int aDestSize, int aWindow,
+        const std::function<void(const unsigned char*, int)>& aSink);
 
 void E32Parser::DecompressImage()
 {
-    if(!iFileName || !iHdr->iCompressionType) // require file for decompression!!!
+    // in-memory images come from E32ImageFile not compressed yet
+    if(!iFileName || !iHdr->iCompressionType)
         return;
 
+    std::streamoff compressedSize = iE32Size;
     uint32_t buf_size = iHdrJ->iUncompressedSize;
     iE32Size = Adjust(buf_size + iHdr->iCodeOffset);
 
     if(iHdr->iCompressionType == KUidCompressionDeflate)
     {
-        char *decompress = new char[buf_size]();
-        uint32_t destsize = buf_size;
-        uint32_t remainder = iE32Size - iHdr->iCodeOffset;
-        InflateUnCompress( (unsigned char*)(iBufferedFile+iHdr->iCodeOffset),
-                          remainder, (unsigned char*)(decompress), destsize);
-
+        // inflate from the loaded file straight into the new buffer
+        size_t offset = iHdr->iCodeOffset;
         char *newBuf = new char[iE32Size]();
-        memcpy(newBuf, iBufferedFile, iHdr->iCodeOffset);
-        memcpy(newBuf + iHdr->iCodeOffset, decompress, buf_size);
-        memset(iBufferedFile, -1, iHdr->iCodeOffset); // will see if use old header
-        delete iBufferedFile;
-        iBufferedFile = nullptr;
+        memcpy(newBuf, iBufferedFile, offset);
+
+        uint32_t destsize = 0;
+        try
+        {
+            destsize = InflateUnCompress((unsigned char*)(iBufferedFile + offset),
+                (int)(compressedSize - offset), (unsigned char*)(newBuf + offset), buf_size);
+        }
+        catch(...)
+        {
+            delete[] newBuf;
+            throw;
+        }
+        delete[] iBufferedFile;
         iBufferedFile = newBuf;
 
         if (destsize != buf_size)
@@ -134,30 +145,35 @@ void E32Parser::DecompressImage()
     }
     else if(iHdr->iCompressionType ==KUidCompressionBytePair)
     {
-        // that bytepair decompression doesn't support in-memory operation =(
-        // so rereading file =(
-
+        // pages are unpacked from the loaded file straight into the new buffer
         size_t offset = iHdr->iCodeOffset;
-        size_t fullsize = iHdr->iCodeOffset + iHdrJ->iUncompressedSize;
-        delete iBufferedFile;
-        iBufferedFile = nullptr;
-        iBufferedFile = new char[fullsize]();
-        std::ifstream is(iFileName, std::ifstream::in | std::ifstream::binary);
-        if(!is.is_open())
-            throw Elf2e32Error(FILEOPENERROR, iFileName);
+        const uint8_t *src = (uint8_t *)iBufferedFile + offset;
+        int32_t srcSize = (int32_t)(compressedSize - offset);
+        int32_t srcUsed = 0;
 
-        is.read(iBufferedFile, offset);
-
-        // Read and decompress code part of the image
-        unsigned int uncompressedCodeSize = DecompressPages((uint8_t *)(iBufferedFile + offset), is);
-
-		// Read and decompress data part of the image
-		offset+=uncompressedCodeSize;
-		unsigned int uncompressedDataSize = DecompressPages((uint8_t *)(iBufferedFile + offset), is);
-
-		is.close();
+        char *newBuf = new char[iE32Size]();
+        memcpy(newBuf, iBufferedFile, offset);
+
+        // Decompress code part of the image
+        int32_t uncompressedCodeSize = DecompressPages((uint8_t *)(newBuf + offset), buf_size,
+                                                        src, srcSize, srcUsed);
+        int32_t uncompressedDataSize = KErrCorrupt;
+        if(uncompressedCodeSize >= 0)
+        {
+            // Decompress data part of the image
+            offset += uncompressedCodeSize;
+            src += srcUsed;
+            srcSize -= srcUsed;
+            uncompressedDataSize = DecompressPages((uint8_t *)(newBuf + offset), buf_size - uncompressedCodeSize,
+                                                    src, srcSize, srcUsed);
+        }
+
+        delete[] iBufferedFile;
+        iBufferedFile = newBuf;
 
-		if (uncompressedCodeSize + uncompressedDataSize != buf_size)
+        if(uncompressedDataSize < 0)
+            throw Elf2e32Error(BYTEPAIRINCONSISTENTSIZEERROR);
+		if ((uint32_t)(uncompressedCodeSize + uncompressedDataSize) != buf_size)
 			Message::GetInstance()->ReportMessage(WARNING, BYTEPAIRINCONSISTENTSIZEERROR);
     }
     else
@@ -168,6 +184,102 @@ void E32Parser::DecompressImage()
     iHdrJ = (E32ImageHeaderJ*)(iBufferedFile + pos);
 }
 
+/** \brief Decompress the image section by section without loading it.
+ *
+ * Only the header and a window of compressed and decompressed data are held
+ * in memory, so memory use doesn't depend on the image size. Pieces never
+ * cross the start of a section (code, data, imports, relocations).
+ * Works on the file given to the ctor, GetFileLayout() is not needed.
+ *
+ * \param aVisitor - receives the uncompressed image, header included, in order
+ * \param aWindow - max size of a piece
+ *
+ */
+void E32Parser::StreamImage(const SectionVisitor& aVisitor, uint32_t aWindow)
+{
+    // images in memory are never compressed and need no streaming
+    if(!iFileName)
+        throw Elf2e32Error(FILEOPENERROR, "E32 image in memory");
+    fstream fs(iFileName, fstream::binary | fstream::in);
+    if(!fs)
+        throw Elf2e32Error(FILEOPENERROR, iFileName);
+    fs.seekg(0, fs.end);
+    std::streamoff fileSize = fs.tellg();
+    fs.seekg(0, fs.beg);
+
+    E32ImageHeader hdr;
+    if(!fs.read((char*)&hdr, sizeof(hdr)) || hdr.iCodeOffset < sizeof(hdr) || hdr.iCodeOffset > fileSize)
+        throw Elf2e32Error(FILEREADERROR, iFileName);
+    std::vector<char> header(hdr.iCodeOffset);
+    memcpy(header.data(), &hdr, sizeof(hdr));
+    if(!fs.read(header.data() + sizeof(hdr), hdr.iCodeOffset - sizeof(hdr)))
+        throw Elf2e32Error(FILEREADERROR, iFileName);
+    const E32ImageHeaderJ* hdrJ = (const E32ImageHeaderJ*)(header.data() + sizeof(hdr));
+
+    // sections start at these offsets, pieces are cut there
+    std::vector<uint32_t> starts = {hdr.iDataOffset, hdr.iImportOffset,
+                                    hdr.iCodeRelocOffset, hdr.iDataRelocOffset};
+    std::sort(starts.begin(), starts.end());
+    uint32_t offset = 0;
+    auto emit = [&](const char* aData, uint32_t aSize)
+    {
+        while(aSize)
+        {
+            uint32_t size = aSize;
+            for(uint32_t s: starts)
+            {
+                if(s > offset && s - offset < size)
+                {
+                    size = s - offset;
+                    break;
+                }
+            }
+            aVisitor(offset, aData, size);
+            offset += size;
+            aData += size;
+            aSize -= size;
+        }
+    };
+    emit(header.data(), hdr.iCodeOffset);
+
+    int32_t srcSize = (int32_t)(fileSize - hdr.iCodeOffset);
+    uint32_t bodySize = hdr.iCompressionType ? hdrJ->iUncompressedSize : srcSize;
+    if(!hdr.iCompressionType)
+    {
+        std::vector<char> window(aWindow);
+        while(srcSize > 0)
+        {
+            uint32_t size = srcSize < (int32_t)aWindow ? srcSize : aWindow;
+            if(!fs.read(window.data(), size))
+                throw Elf2e32Error(FILEREADERROR, iFileName);
+            emit(window.data(), size);
+            srcSize -= size;
+        }
+    }
+    else if(hdr.iCompressionType == KUidCompressionDeflate)
+    {
+        uint32_t size = InflateStream(fs, srcSize, bodySize, aWindow,
+            [&](const unsigned char* aData, int aSize){ emit((const char*)aData, aSize); });
+        if(size != bodySize)
+            Message::GetInstance()->ReportMessage(WARNING, HUFFMANINCONSISTENTSIZEERROR);
+    }
+    else if(hdr.iCompressionType == KUidCompressionBytePair)
+    {
+        auto sink = [&](const uint8_t* aData, int32_t aSize){ emit((const char*)aData, aSize); };
+        int32_t srcUsed = 0;
+        int32_t codeSize = StreamPages(fs, srcSize, sink, srcUsed);
+        int32_t dataSize = KErrCorrupt;
+        if(codeSize >= 0)
+            dataSize = StreamPages(fs, srcSize - srcUsed, sink, srcUsed);
+        if(dataSize < 0)
+            throw Elf2e32Error(BYTEPAIRINCONSISTENTSIZEERROR);
+        if((uint32_t)(codeSize + dataSize) != bodySize)
+            Message::GetInstance()->ReportMessage(WARNING, BYTEPAIRINCONSISTENTSIZEERROR);
+    }
+    else
+        throw Elf2e32Error(UNKNOWNCOMPRESSION);
+}
+
 TExceptionDescriptor* E32Parser::GetExceptionDescriptor() const
 {
     uint32_t xd = iHdrV->iExceptionDescriptor;
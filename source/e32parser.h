@@ -23,6 +23,7 @@
 #include <ios>
 #include <cstdint>
 #include <stddef.h>
+#include <functional>
 
 struct E32ImageHeader;
 struct E32ImageHeaderJ;
@@ -32,6 +33,10 @@ struct E32ImportSection;
 class E32Parser
 {
     public:
+        /** Receives a piece of the uncompressed image: its offset in the image, data and size */
+        typedef std::function<void(uint32_t aOffset, const char* aData, uint32_t aSize)> SectionVisitor;
+        enum {KStreamWindow = 0x10000};
+
         E32Parser(const char* fileName, const char* fileBuf = nullptr);
         ~E32Parser();
 
@@ -53,6 +58,8 @@ class E32Parser
         size_t GetFileSize() const;
         int32_t GetExportDescription();
         E32RelocSection *GetRelocSection(uint32_t offSet);
+
+        void StreamImage(const SectionVisitor& aVisitor, uint32_t aWindow = KStreamWindow);
     private:
         void ReadFile();
         void ParseExportBitMap();
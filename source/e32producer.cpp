@@ -24,12 +24,12 @@
 #include "e32producer.h"
 #include "errorhandler.h"
 #include "e32validator.h"
+#include "pagedcompress.h"
 #include "parametermanager.h"
 
 using std::ofstream;
 
-void DeflateCompress(char *buf, size_t size, ofstream & os);
-void CompressPages(uint8_t *buf, int32_t size, ofstream& os);
+void DeflateCompress(char *buf, size_t size, std::ostream & os, CompressionLevel level);
 
 E32Producer::E32Producer(ParameterManager *args) : iMan(args)
 {
@@ -79,22 +79,32 @@ void E32Producer::SaveE32(const char* s, size_t size)
         throw Elf2e32Error(FILEOPENERROR, iMan->E32ImageOutput());
 
     uint32_t compression = iE32Hdr->iCompressionType;
-    if(compression > 0)
+    if(iMan->CompressionAuto())
+    {
+        // the header is written once the compression method is chosen
+        uint32_t offset = iE32Hdr->iCodeOffset;
+        std::string body;
+        iE32Hdr->iCompressionType = CompressBest((uint8_t*)(s + offset), size - offset,
+            iE32Hdr->iCodeSize, iMan->GetCompressionLevel(), iMan->CompressionMargin(), body);
+        fs.write(s, offset);
+        fs.write(body.data(), body.size());
+    }
+    else if(compression > 0)
     {
         uint32_t offset = iE32Hdr->iCodeOffset;
         fs.write(s, offset);
 
         if(compression == KUidCompressionDeflate)
-            DeflateCompress((char*)s + offset, size - offset, fs);
+            DeflateCompress((char*)s + offset, size - offset, fs, iMan->GetCompressionLevel());
 
         else if (compression == KUidCompressionBytePair)
         {
             // Compress and write out code part
-            CompressPages( (uint8_t*)(s + offset), iE32Hdr->iCodeSize, fs);
+            CompressPages( (uint8_t*)(s + offset), iE32Hdr->iCodeSize, fs, iMan->GetCompressionLevel());
 
             // Compress and write out data part
 			offset += iE32Hdr->iCodeSize;
-			CompressPages( (uint8_t*)(s + offset), size - offset, fs);
+			CompressPages( (uint8_t*)(s + offset), size - offset, fs, iMan->GetCompressionLevel());
         }
     }
     else
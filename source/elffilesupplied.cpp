@@ -14,9 +14,11 @@
 // Description:
 //
 
-#include <algorithm>
+#include <vector>
+#include <algorithm>
 #include <iostream>
 #include <cstring>
+#include <unordered_map>
 
 #include "deffile.h"
 #include "pl_symbol.h"
@@ -27,11 +29,12 @@
 #include "pl_elfproducer.h"
 #include "elffilesupplied.h"
 #include "staticlibsymbols.h"
-#include "parametermanager.h"
+#include "parametermanager.h"
 
 using std::cout;
-bool UnWantedSymbol(const char * aSymbol);
-Symbols GetExports(ParameterManager *param);
+using std::vector;
+bool UnWantedSymbol(const char * aSymbol);
+Symbols GetExports(ParameterManager *param);
 
 /**
 Constructor for class ElfFileSupplied
@@ -39,7 +42,7 @@ Constructor for class ElfFileSupplied
 @internalComponent
 @released
 */
-ElfFileSupplied::ElfFileSupplied(ParameterManager* aManager) :
+ElfFileSupplied::ElfFileSupplied(ParameterManager* aManager) :
     iManager(aManager)
 {
 	iElfProducer = new ElfProducer(aManager->ElfInput());
@@ -66,8 +69,8 @@ Execute Function for the Elf File Supplied use case
 @released
 */
 void ElfFileSupplied::Execute()
-{
-    ReadElfFile();
+{
+    ReadElfFile();
     ProcessExports();
 	BuildAll();
 }
@@ -78,11 +81,11 @@ Function to read ELF File
 @released
 */
 void ElfFileSupplied::ReadElfFile()
-{
-    if(iManager->ElfInput().empty())
-        return;
+{
+    if(iManager->ElfInput().empty())
+        return;
 	iReader->ProcessElfFile();
-}
+}
 
 /**
 Function to process exports
@@ -90,11 +93,12 @@ Function to process exports
 @released
 */
 void ElfFileSupplied::ProcessExports()
-{
-    Symbols def = GetExports(iManager);
-    try
-    {
-        ValidateDefExports(def);    }
+{
+    Symbols def = GetExports(iManager);
+    try
+    {
+        ValidateDefExports(def);
+    }
     catch(SymbolMissingFromElfError& e)
 	{
 		/* Only DEF file would be generated if symbols found in
@@ -102,7 +106,7 @@ void ElfFileSupplied::ProcessExports()
 		 */
 		WriteDefFile();
 		throw;
-	}
+	}
 	CreateExports();
 }
 
@@ -113,7 +117,7 @@ Function to write DEF File
 */
 void ElfFileSupplied::WriteDefFile()
 {
-	char * aDEFFileName = iManager->DefOutput();
+	char * aDEFFileName = iManager->DefOutput();
 	if(!aDEFFileName) return;
 
 	DefFile deffile;
@@ -132,7 +136,30 @@ void ElfFileSupplied::CreateExports()
 		iExportTable.CreateExportTable(iReader);
 		CreateExportBitMap();
 	}
-}
+}
+
+/** Hash of zero terminated symbol names */
+struct ExportNameHash
+{
+	size_t operator()(const char* aName) const
+	{
+		size_t h = 2166136261u;
+		for(; *aName; aName++)
+			h = (h ^ (unsigned char)*aName) * 16777619u;
+		return h;
+	}
+};
+
+struct ExportNameEqual
+{
+	bool operator()(const char* aLhs, const char* aRhs) const
+	{
+		return aLhs == aRhs || !strcmp(aLhs, aRhs);
+	}
+};
+
+/** ELF exports by name: index of the first export with the name */
+typedef std::unordered_map<const char*, size_t, ExportNameHash, ExportNameEqual> ExportNameIndex;
 
 /**
 Function to validate exports
@@ -141,7 +168,7 @@ Function to validate exports
 @released
 */
 void ElfFileSupplied::ValidateDefExports(Symbols &aDefExports)
-{
+{
 	/**
 	 * Symbols from DEF file (DEF_Symbols) => Valid_DEF + Absent
 	 * Symbols from ELF file (ELF_Symbols) => Existing  + NEW
@@ -154,69 +181,93 @@ void ElfFileSupplied::ValidateDefExports(Symbols &aDefExports)
 	 *		add them into the new list retaining the ordinal number as of the
 	 *		absent symbol(using PtrELFExportNameCompareUpdateOrdinal).
 	 **/
-
+
     if (aDefExports.empty())
 		return;
-
-    if(iManager->ElfInput().empty())
-    {
-        iSymbols = aDefExports;
-        return;
-    }
-
-	PLUINT32 aMaxOrdinal = 0;
-	int len = strlen("_ZTI");
-
-	typedef Symbols::iterator Iterator;
-
-
-	//Symbols aDefExports, defValidExports, defAbsentExports, elfExports;
-	Symbols defValidExports, defAbsentExports, elfExports;
 
-    for(auto x: aDefExports)
+    if(iManager->ElfInput().empty())
     {
-        if( x->Absent() ){
-            defAbsentExports.push_back(x);
-        }
-        else {
-            defValidExports.push_back(x);
-        }
-
-        if( aMaxOrdinal < x->OrdNum() ){
-            aMaxOrdinal = x->OrdNum();
-        }
+        iSymbols = aDefExports;
+        return;
     }
 
-	iSymbols = defValidExports;
+	PLUINT32 aMaxOrdinal = 0;
+	int len = strlen("_ZTI");
+	ElfExports::PtrELFExportNameCompareUpdateAttributes aUpdate;
 
+	// ELF exports come sorted by name, so walking them keeps the
+	// warnings and the new ordinals in name order
+	Symbols elfSymbols;
 	if (iReader->iExports)
-		elfExports = iReader->GetElfSymbols();
-
-	// REVISIT - return back if elfexports and defexports is NULL
+		elfSymbols = iReader->GetElfSymbols();
+	vector<Symbol*> elfExports(elfSymbols.begin(), elfSymbols.end());
+
+	ExportNameIndex aElfIndex(elfExports.size());
+	for(size_t i = 0; i < elfExports.size(); i++)
+		aElfIndex.emplace(elfExports[i]->SymbolName(), i);
+
+	// DEF symbol paired with each ELF export, a DEF name paired at most once
+	// like in a sorted merge: repeated names take the following equal exports
+	vector<Symbol*> aValidMatch(elfExports.size(), nullptr);
+	vector<Symbol*> aAbsentMatch(elfExports.size(), nullptr);
+	auto Pair = [&](vector<Symbol*>& aMatch, Symbol* aSym)
+	{
+		auto it = aElfIndex.find(aSym->SymbolName());
+		if(it == aElfIndex.end())
+			return false;
+		for(size_t i = it->second; i < elfExports.size() &&
+			!strcmp(elfExports[i]->SymbolName(), aSym->SymbolName()); i++)
+		{
+			if(!aMatch[i])
+			{
+				aMatch[i] = aSym;
+				return true;
+			}
+		}
+		return false;
+	};
 
-	defValidExports.sort(ElfExports::PtrELFExportNameCompare());
-	elfExports.sort(ElfExports::PtrELFExportNameCompare());
+	vector<Symbol*> defMissing, defAbsentMissing;
+	bool aHasAbsent = false;
+	iSymbols.clear();
+	for(auto x: aDefExports)
+	{
+		if( x->Absent() ){
+			aHasAbsent = true;
+			if(!Pair(aAbsentMatch, x))
+				defAbsentMissing.push_back(x);
+		}
+		else {
+			iSymbols.push_back(x);
+			if(!Pair(aValidMatch, x))
+				defMissing.push_back(x);
+		}
 
-	defAbsentExports.sort(ElfExports::PtrELFExportNameCompare());
+		if( aMaxOrdinal < x->OrdNum() ){
+			aMaxOrdinal = x->OrdNum();
+		}
+	}
 
 	//Check for Case 1... {Valid_DEF - ELF_Symbols}
 	{
-		Symbols aResult(defValidExports.size());
-		Iterator aResultPos = aResult.begin();
-
-		Iterator aMissingListEnd = set_difference(defValidExports.begin(), defValidExports.end(),
-                elfExports.begin(), elfExports.end(), aResultPos,
-                ElfExports::PtrELFExportNameCompareUpdateAttributes());
+		for(size_t i = 0; i < elfExports.size(); i++)
+		{
+			if(!aValidMatch[i])
+				continue;
+			// share ordinal and size both ways as the merge comparator did
+			aUpdate(aValidMatch[i], elfExports[i]);
+			aUpdate(elfExports[i], aValidMatch[i]);
+			aValidMatch[i]->SetSymbolStatus(Matching);
+		}
 
+		std::stable_sort(defMissing.begin(), defMissing.end(), ElfExports::PtrELFExportNameCompare());
 		std::list<string> aMissingSymNameList;
-		while (aResultPos != aMissingListEnd) {
+		for(auto x: defMissing) {
 			// {Valid_DEF - ELF_Symbols} is non empty
-			(*aResultPos)->SetSymbolStatus(Missing); // Set the symbol Status as Missing
-			aMissingSymNameList.push_back((*aResultPos)->SymbolName());
-			++aResultPos;
-			//throw error
-		}
-		if( !aMissingSymNameList.empty() ) {
+			x->SetSymbolStatus(Missing); // Set the symbol Status as Missing
+			aMissingSymNameList.push_back(x->SymbolName());
+		}
+		if( !aMissingSymNameList.empty() ) {
 			if (!iManager->Unfrozen())
 				throw SymbolMissingFromElfError(SYMBOLMISSINGFROMELFERROR, aMissingSymNameList, iManager->ElfInput().c_str());
 			else
@@ -225,105 +276,73 @@ void ElfFileSupplied::ValidateDefExports(Symbols &aDefExports)
 	}
 
 	//Check for Case 2... intersection set {Absent,ELF_Symbols}
+	for(size_t i = 0; i < elfExports.size(); i++)
 	{
-		if(!defAbsentExports.empty())
-		{
-			Symbols aResult(defAbsentExports.size());
-			Iterator aResultPos = aResult.begin();
-
-			Iterator aAbsentListEnd = set_intersection(defAbsentExports.begin(), defAbsentExports.end(), \
-				elfExports.begin(), elfExports.end(), aResultPos, ElfExports::PtrELFExportNameCompareUpdateAttributes());
-
-			while( aResultPos != aAbsentListEnd )
-			{
-				// intersection set {Absent,ELF_Symbols} is non-empty
-
-				iSymbols.insert(iSymbols.end(), *aResultPos);
-				cout << "Elf2e32: Warning: Symbol " << (*aResultPos)->SymbolName() << " absent in the DEF file, but present in the ELF file" << "\n";
-				++aResultPos;
-			}
-		}
+		Symbol* aAbsent = aAbsentMatch[i];
+		if(!aAbsent)
+			continue;
+		// the ELF export takes the ordinal and the absent mark of the DEF symbol
+		aUpdate(aAbsent, elfExports[i]);
+		aUpdate(elfExports[i], aAbsent);
+		iSymbols.push_back(aAbsent);
+		cout << "Elf2e32: Warning: Symbol " << aAbsent->SymbolName() << " absent in the DEF file, but present in the ELF file" << "\n";
 	}
 
-	//Do 3
+	//Do 3... {ELF_Symbols - Valid_DEF}
 	{
-		Symbols aResult(elfExports.size());
-		Iterator aResultPos = aResult.begin();
-
-		Iterator aNewListEnd = set_difference(elfExports.begin(), elfExports.end(), \
-			defValidExports.begin(), defValidExports.end(), aResultPos, ElfExports::PtrELFExportNameCompare());
-
 		bool aIgnoreNonCallable = iManager->IgnoreNonCallable();
 		bool aIsCustomDll = iManager->IsCustomDllTarget();
 		bool aExcludeUnwantedExports = iManager->ExcludeUnwantedExports();
 
-		while( aResultPos != aNewListEnd )
+		for(size_t i = 0; i < elfExports.size(); i++)
 		{
-
-			if( !(*aResultPos)->Absent() )
+			Symbol* aSym = elfExports[i];
+			if( aValidMatch[i] || aSym->Absent() )
+				continue;
+
+			/* For a custom dll and for option "--excludeunwantedexports", the new exports should be filtered,
+			 * so that only the exports from the frozen DEF file are considered.
+			 */
+			if ((aIsCustomDll || aExcludeUnwantedExports) && UnWantedSymbol(aSym->SymbolName()))
 			{
-				/* For a custom dll and for option "--excludeunwantedexports", the new exports should be filtered,
-				 * so that only the exports from the frozen DEF file are considered.
-				 */
-				if ((aIsCustomDll || aExcludeUnwantedExports) && UnWantedSymbol((*aResultPos)->SymbolName()))
+				iReader->iExports->ExportsFilteredP(true);
+				iReader->iExports->iFilteredExports.push_back(aSym);
+				continue;
+			}
+			if (aIgnoreNonCallable)
+			{
+				// Ignore the non callable exports
+				if ((!strncmp("_ZTI", aSym->SymbolName(), len)) ||
+				    (!strncmp("_ZTV", aSym->SymbolName(), len)))
 				{
 					iReader->iExports->ExportsFilteredP(true);
-					iReader->iExports->iFilteredExports.push_back((Symbol *)(*aResultPos));
-					++aResultPos;
+					iReader->iExports->iFilteredExports.push_back(aSym);
 					continue;
 				}
-				if (aIgnoreNonCallable)
-				{
-					// Ignore the non callable exports
-					if ((!strncmp("_ZTI", (*aResultPos)->SymbolName(), len)) ||
-					    (!strncmp("_ZTV", (*aResultPos)->SymbolName(), len)))
-					{
-						iReader->iExports->ExportsFilteredP(true);
-						iReader->iExports->iFilteredExports.push_back((Symbol *)(*aResultPos));
-						++aResultPos;
-						continue;
-					}
-				}
-				(*aResultPos)->SetOrdinal( ++aMaxOrdinal );
-				(*aResultPos)->SetSymbolStatus(New); // Set the symbol Status as NEW
-				iSymbols.push_back(*aResultPos);
-				if(WarnForNewExports())
-					cout << "Elf2e32: Warning: New Symbol " << (*aResultPos)->SymbolName() << " found, export(s) not yet Frozen" << "\n";
 			}
-			++aResultPos;
+			aSym->SetOrdinal( ++aMaxOrdinal );
+			aSym->SetSymbolStatus(New); // Set the symbol Status as NEW
+			iSymbols.push_back(aSym);
+			if(WarnForNewExports())
+				cout << "Elf2e32: Warning: New Symbol " << aSym->SymbolName() << " found, export(s) not yet Frozen" << "\n";
 		}
 	}
 
-	//Do 4
+	//Do 4... absent symbols missing from ELF keep their ordinals
+	if(aHasAbsent)
 	{
-		if(!defAbsentExports.empty())
-		{
-			Symbols aResult(defAbsentExports.size());
-			Iterator aResultPos = aResult.begin();
-
-			Iterator aAbsentListEnd = set_difference(defAbsentExports.begin(), defAbsentExports.end(), \
-				elfExports.begin(), elfExports.end(), aResultPos, ElfExports::PtrELFExportNameCompareUpdateAttributes());
-
-			while( aResultPos != aAbsentListEnd  ) {
-				//aElfExports.insert(aElfExports.end(), *aResultPos);
-				Symbol *sym = new Symbol( *(*aResultPos), SymbolTypeCode, true);
-				iReader->iExports->Add(iReader->iSOName, sym);
-				//aElfExports.insert(aElfExports.end(), (Symbol*)aSymbol);
-				iSymbols.push_back(sym);
-				++aResultPos;
-			}
-			elfExports.sort(ElfExports::PtrELFExportOrdinalCompare());
-			iSymbols.sort(ElfExports::PtrELFExportOrdinalCompare());
+		std::stable_sort(defAbsentMissing.begin(), defAbsentMissing.end(), ElfExports::PtrELFExportNameCompare());
+		for(auto x: defAbsentMissing) {
+			Symbol *sym = new Symbol( *x, SymbolTypeCode, true);
+			iReader->iExports->Add(iReader->iSOName, sym);
+			iSymbols.push_back(sym);
 		}
+		iSymbols.sort(ElfExports::PtrELFExportOrdinalCompare());
 	}
 
 	if(iReader->iExports && iReader->iExports->ExportsFilteredP() ) {
 		iReader->iExports->FilterExports();
 	}
-
-	elfExports.clear();
-	defAbsentExports.clear();
-	defValidExports.clear();
 }
 
 /**
@@ -346,12 +365,12 @@ Function to write DSO file.
 */
 void ElfFileSupplied::WriteDSOFile()
 {
-	char * aDSOName = iManager->DSOOutput();
-	if(!aDSOName)
-	    return;
-
+	char * aDSOName = iManager->DSOOutput();
+	if(!aDSOName)
+	    return;
+
 	char * aDSOFileName = iManager->FileName(aDSOName);
-	char * aLinkAs = iManager->LinkAsDLLName();
+	char * aLinkAs = iManager->LinkAsDLLName();
 
 	/** This member is responsible for generating the proxy DSO file. */
 
@@ -367,12 +386,12 @@ Function to write E32 Image file.
 void ElfFileSupplied::WriteE32()
 {
 	const char * e32 = iManager->E32ImageOutput();
-
-    if(!e32)
-	    return;
-
-    if(iManager->ElfInput().empty())
-        throw Elf2e32Error(NOREQUIREDOPTIONERROR, "--elfinput");
+
+    if(!e32)
+	    return;
+
+    if(iManager->ElfInput().empty())
+        throw Elf2e32Error(NOREQUIREDOPTIONERROR, "--elfinput");
 
 	iE32ImageFile = new E32ImageFile(iReader, this, iManager, &iExportTable);
 
@@ -417,7 +436,7 @@ E32ImageHeaderV * ElfFileSupplied::AllocateE32ImageHeader()
 		return new E32ImageHeaderV;
 	}
 
-	int nexp = iExportTable.GetNumExports();
+	int nexp = iExportTable.GetNumExports();
 
 	size_t memsz = (nexp + 7) >> 3;	// size of complete bitmap
 	size_t mbs = (memsz + 7) >> 3;	// size of meta-bitmap
@@ -545,12 +564,12 @@ Function to provide a predicate which checks whether a symbol name is unwanted:
 */
 bool UnWantedSymbol(const char * aSymbol)
 {
-	constexpr size_t symbollistsize = sizeof(Unwantedruntimesymbols) / sizeof(Unwantedruntimesymbols[0]);
-	for (size_t i = 0; i<symbollistsize; i++)
-	{
-		if (strstr(Unwantedruntimesymbols[i], aSymbol))
-			return true;
-	}
+	constexpr size_t symbollistsize = sizeof(Unwantedruntimesymbols) / sizeof(Unwantedruntimesymbols[0]);
+	for (size_t i = 0; i<symbollistsize; i++)
+	{
+		if (strstr(Unwantedruntimesymbols[i], aSymbol))
+			return true;
+	}
 	return false;
 }
 
@@ -55,7 +55,7 @@ void ExportProcessor::SymbolsFromSysdefOption(Symbols &s)
 	for(int i =  0; i < count; i++)
 	{
 		sysDefSyms[i] = iMan->SysDefSymbols(i);
-		Symbol *sym = new Symbol(sysDefSyms[i].iSysDefSymbolName, SymbolTypeCode);
+		Symbol *sym = new Symbol(sysDefSyms[i].iSysDefSymbolName.c_str(), SymbolTypeCode);
 		sym->SetOrdinal(sysDefSyms[i].iSysDefOrdinalNum);
 		s.push_back(sym);
 	}
@@ -45,7 +45,7 @@ Following construction the bit stream is ready for writing bits, but will first
 OverflowL() as the output buffer is 'full'. A derived class can detect this state as
 Ptr() will return null.
 */
-TBitOutput::TBitOutput():iCode(0),iBits(-8),iPtr(nullptr),iEnd(nullptr)
+TBitOutput::TBitOutput():iCode(0),iBits(0),iPtr(nullptr),iEnd(nullptr)
 {
 }
 
@@ -59,7 +59,7 @@ for further output.
 @param "TUint8* aBuf" The buffer for output
 @param "TInt aSize" The size of the buffer in bytes
 */
-TBitOutput::TBitOutput(TUint8* aBuf,TInt aSize):iCode(0),iBits(-8),iPtr(aBuf),iEnd(aBuf+aSize)
+TBitOutput::TBitOutput(TUint8* aBuf,TInt aSize):iCode(0),iBits(0),iPtr(aBuf),iEnd(aBuf+aSize)
 {
 }
 
@@ -104,50 +104,67 @@ next byte.
 */
 void TBitOutput::PadL(TUint aPadding)
 {
-	if (iBits>-8)
-		WriteL(aPadding?0xffffffffu:0,-iBits);
+	if (iBits&7)
+		WriteL(aPadding?0xffffffffu:0,8-(iBits&7));
+	// write out the whole bytes left
+	for (;iBits>0;iBits-=8)
+	{
+		WriteByteL(TUint8(iCode>>56));
+		iCode<<=8;
+	}
+	iBits=0;
+}
+
+/**
+Write a single byte to the buffer
+@internalComponent
+@released
+*/
+inline void TBitOutput::WriteByteL(TUint8 aByte)
+{
+	if (iPtr==iEnd)
+	{
+		// run out of buffer space so invoke the overflow handler
+		OverflowL();
+		assert(iPtr!=iEnd);
+	}
+	*iPtr++=aByte;
 }
 
 /**
 Write the higher order bits to the stream
+
+The bits are collected in a 64-bit accumulator and written out a 32-bit word at a time.
 @internalComponent
 @released
 */
 void TBitOutput::DoWriteL(TUint aBits,TInt aSize)
 {
-	if (aSize>25)
+	assert(aSize<=32);
+	iCode|=TUint64(aBits)<<(32-iBits);
+	iBits+=aSize;
+	if (iBits<32)
+		return;
+
+	TUint word=TUint(iCode>>32);
+	TUint8* p=iPtr;
+	if (iEnd-p>=4)
 	{
-		// cannot process >25 bits in a single pass so do the top 8 bits first
-		assert(aSize<=32);
-		DoWriteL(aBits&0xff000000u,8);
-		aBits<<=8;
-		aSize-=8;
+		p[0]=TUint8(word>>24);
+		p[1]=TUint8(word>>16);
+		p[2]=TUint8(word>>8);
+		p[3]=TUint8(word);
+		iPtr=p+4;
 	}
-
-	TInt bits=iBits;
-	TUint code=iCode|(aBits>>(bits+8));
-	bits+=aSize;
-	if (bits>=0)
+	else
 	{
-		TUint8* p=iPtr;
-		do
-		{
-			if (p==iEnd)
-			{
-				// run out of buffer space so invoke the overflow handler
-				iPtr=p;
-				OverflowL();
-				p=iPtr;
-				assert(p!=iEnd);
-			}
-			*p++=TUint8(code>>24);
-			code<<=8;
-			bits-=8;
-		} while (bits>=0);
-		iPtr=p;
+		WriteByteL(TUint8(word>>24));
+		WriteByteL(TUint8(word>>16));
+		WriteByteL(TUint8(word>>8));
+		WriteByteL(TUint8(word));
 	}
-	iCode=code;
-	iBits=bits;
+	iCode<<=32;
+	iBits-=32;
 }
 
 /**
@@ -186,6 +203,39 @@ void TFileOutput::FlushL()
 	}
 }
 
+/**
+Constructor for class TBufferOutput
+@param aBuf - the buffer to write into, its initial size is the first capacity to use
+@internalComponent
+@released
+*/
+TBufferOutput::TBufferOutput(std::vector<TUint8>& aBuf): iBuf(aBuf)
+{
+	Set(iBuf.data(),iBuf.size());
+}
+
+/**
+Function to grow the buffer and reset the pointers
+@internalComponent
+@released
+*/
+void TBufferOutput::OverflowL()
+{
+	size_t used=Size();
+	iBuf.resize(iBuf.size()<0x1000 ? 0x1000 : iBuf.size()*2);
+	Set(iBuf.data()+used,iBuf.size()-used);
+}
+
+/**
+Function returns the number of bytes written to the buffer
+@internalComponent
+@released
+*/
+TInt TBufferOutput::Size() const
+{
+	return Ptr()-iBuf.data();
+}
+
 /**
 Recursive function to calculate the code lengths from the node tree
 @internalComponent
@@ -611,6 +661,116 @@ void Huffman::Decoding(const TUint32 aHuffman[],TInt aNumCodes,TUint32 aDecodeTr
 		HuffmanSubTree(aDecodeTree+codes-1,aDecodeTree+codes-1,&level[0]);
 }
 
+/**
+Create a canonical Huffman decoding table
+
+This generates the lookup table used by TBitInput::HuffmanL() to read huffman encoded data
+with a few table probes per symbol instead of one tree step per bit. Symbols decoded are the
+same as with the decoding tree from the other overload of Decoding().
+
+@param "const TUint32 aHuffman[]" The table of code lengths as generated by Huffman::HuffmanL()
+@param "TInt aNumCodes" The number of codes in the table
+@param "THuffmanTable& aTable" The decoding table to build
+@param "TInt aSymbolBase" the base value for the output 'symbols', by default this is zero.
+
+@see IsValid()
+@see HuffmanL()
+*/
+void Huffman::Decoding(const TUint32 aHuffman[],TInt aNumCodes,THuffmanTable& aTable,TInt aSymbolBase)
+{
+	if(!IsValid(aHuffman,aNumCodes))
+		throw Elf2e32Error(HUFFMANINVALIDCODINGERROR);
+
+	const TInt KRootBits=THuffmanTable::KRootBits;
+	const TInt KLengthBits=THuffmanTable::KLengthBits;
+
+	TUint16* counts=aTable.iCounts;
+	memset(counts,0,sizeof(aTable.iCounts));
+	TInt codes=0;
+	TInt ii;
+	for (ii=0;ii<aNumCodes;++ii)
+	{
+		if (aHuffman[ii])
+		{
+			++counts[aHuffman[ii]];
+			++codes;
+		}
+	}
+
+	// symbols sorted by code length then by value is the canonical order
+	TFixedArray<TInt,KMaxCodeLength+1> offset;
+	offset[0]=0;
+	for (ii=1;ii<=KMaxCodeLength;++ii)
+		offset[ii]=offset[ii-1]+counts[ii-1];
+	aTable.iSymbols.resize(codes);
+	for (ii=0;ii<aNumCodes;++ii)
+	{
+		if (aHuffman[ii])
+			aTable.iSymbols[offset[aHuffman[ii]]++]=ii+aSymbolBase;
+	}
+
+	aTable.iEntries.assign(1<<KRootBits,0);
+	if (codes==1)	// codes==1 special case: both 0 and 1 decode the symbol
+	{
+		aTable.iEntries.assign(1<<KRootBits,(aTable.iSymbols[0]<<KLengthBits)|1);
+		return;
+	}
+
+	// walk the codes in canonical order, numerically increasing as in Encoding()
+	// first pass sizes the sub-tables: codes sharing a root prefix are adjacent
+	// and the last one is the longest
+	TFixedArray<TInt,1<<KRootBits> subBits;
+	subBits.Reset();
+	TUint code=0;
+	TInt len=0;
+	TInt sym=0;
+	for (TInt l=1;l<=KMaxCodeLength;++l)
+	{
+		for (TInt n=counts[l];n>0;--n,++code)
+		{
+			if (l>KRootBits)
+				subBits[code>>(l-KRootBits)]=l-KRootBits;
+		}
+		code<<=1;
+	}
+	for (ii=0;ii<(1<<KRootBits);++ii)
+	{
+		if (subBits[ii])
+		{
+			aTable.iEntries[ii]=THuffmanTable::KSubTable|(aTable.iEntries.size()<<KLengthBits)|subBits[ii];
+			aTable.iEntries.resize(aTable.iEntries.size()+(1<<subBits[ii]),0);
+		}
+	}
+
+	code=0;
+	for (len=1;len<=KMaxCodeLength;++len)
+	{
+		for (TInt n=counts[len];n>0;--n,++code,++sym)
+		{
+			TUint32 entry=(aTable.iSymbols[sym]<<KLengthBits)|len;
+			TUint32* first;
+			TInt fill;
+			if (len<=KRootBits)
+			{
+				fill=1<<(KRootBits-len);
+				first=&aTable.iEntries[code<<(KRootBits-len)];
+			}
+			else
+			{
+				TUint32 root=aTable.iEntries[code>>(len-KRootBits)];
+				TInt bits=root&THuffmanTable::KLengthMask;
+				TInt extra=len-KRootBits;
+				TUint index=code&((1<<extra)-1);
+				fill=1<<(bits-extra);
+				first=&aTable.iEntries[((root&~THuffmanTable::KSubTable)>>KLengthBits)+(index<<(bits-extra))];
+			}
+			while (fill--)
+				*first++=entry;
+		}
+		code<<=1;
+	}
+}
+
 /**
 The decoding tree for the externalised code
 */
@@ -720,16 +880,15 @@ void Huffman::InternalizeL(TBitInput& aInput,TUint32 aHuffman[],TInt aNumCodes)
 
 /**
 bit-stream input class
-Reverse the byte-order of a 32 bit value
-This generates optimal ARM code (4 instructions)
+Reverse the byte-order of a 64 bit value, the stream is read in big endian order
 */
-inline TUint reverse(TUint aVal)
+inline TUint64 reverse(TUint64 aVal)
 {
-	TUint v=(aVal<<16)|(aVal>>16);
-	v^=aVal;
-	v&=0xff00ffff;
-	aVal=(aVal>>8)|(aVal<<24);
-	return aVal^(v>>8);
+#if defined(_MSC_VER)
+	return _byteswap_uint64(aVal);
+#else
+	return __builtin_bswap64(aVal);
+#endif
 }
 
 /**
@@ -767,26 +926,47 @@ Bits will be read from this buffer until it is empty, at which point UnderflowL(
 @param "TInt aOffset" The bit offset from the start of the buffer to the bit stream (defaults to zero)
 */
 void TBitInput::Set(const TUint8* aPtr, TInt aLength, TInt aOffset)
-{
-	size_t p=(size_t)aPtr;
-	p+=aOffset>>3;			// nearest byte to the specified bit offset
+{
+	iPtr=aPtr+(aOffset>>3);	// nearest byte to the specified bit offset
 	aOffset&=7;				// bit offset within the byte
-	const TUint32* ptr=(const TUint32*)(p&~3);	// word containing this byte
-	aOffset+=(p&3)<<3;		// bit offset within the word
-	if (aLength==0)
-		iCount=0;
-	else
+	iBits=0;
+	iCount=0;
+	iRemain=aLength>0?aLength+aOffset:0;
+	if (aLength>0 && aOffset)
+	{
+		// drop the bits before the stream
+		Refill();
+		iBits<<=aOffset;
+		iCount-=aOffset;
+	}
+}
+
+/**
+Load the stream into the bit buffer
+
+At least 57 bits are available after the call unless the stream ends earlier.
+Bytes beyond the end of the stream are never read.
+*/
+inline void TBitInput::Refill()
+{
+	if (iRemain>=64)
 	{
-		// read the first few bits of the stream
-		iBits=reverse(*ptr++)<<aOffset;
-		aOffset=32-aOffset;
-		aLength-=aOffset;
-		if (aLength<0)
-			aOffset+=aLength;
-		iCount=aOffset;
+		TUint64 w;
+		memcpy(&w,iPtr,sizeof(w));
+		iBits|=reverse(w)>>iCount;
+		TInt bytes=(63-iCount)>>3;
+		iPtr+=bytes;
+		iCount+=bytes<<3;
+		iRemain-=bytes<<3;
+		return;
+	}
+	while (iCount<=56 && iRemain>0)
+	{
+		iBits|=TUint64(*iPtr++)<<(56-iCount);
+		TInt n=iRemain<8?iRemain:8;
+		iCount+=n;
+		iRemain-=n;
 	}
-	iRemain=aLength;
-	iPtr=ptr;
 }
 
 #ifndef __HUFFMAN_MACHINE_CODED__
@@ -804,13 +984,12 @@ data
 */
 TUint TBitInput::ReadL()
 {
-	TInt c=iCount;
-	TUint bits=iBits;
-	if (--c<0)
+	if (iCount==0)
 		return ReadL(1);
-	iCount=c;
-	iBits=bits<<1;
-	return bits>>31;
+	TUint bit=TUint(iBits>>63);
+	iBits<<=1;
+	--iCount;
+	return bit;
 }
 
 /**
@@ -834,44 +1013,22 @@ TUint TBitInput::ReadL(TInt aSize)
 {
 	if (!aSize)
 		return 0;
-	TUint val=0;
-	TUint bits=iBits;
-	iCount-=aSize;
-	while (iCount<0)
+	if (iCount<aSize)
+		Refill();
+	if (iCount<aSize)
 	{
-		// need more bits
-#ifdef __CPU_X86
-		// X86 does not allow shift-by-32
-		if (iCount+aSize!=0)
-			val|=bits>>(32-(iCount+aSize))<<(-iCount);	// scrub low order bits
-#else
-		val|=bits>>(32-(iCount+aSize))<<(-iCount);	// scrub low order bits
-#endif
-		aSize=-iCount;	// bits still required
-		if (iRemain>0)
-		{
-			bits=reverse(*iPtr++);
-			iCount+=32;
-			iRemain-=32;
-			if (iRemain<0)
-				iCount+=iRemain;
-		}
-		else
-		{
-			UnderflowL();
-			bits=iBits;
-			iCount-=aSize;
-		}
+		// take the rest of the stream and ask for more
+		TInt have=iCount;
+		TUint val=have?TUint(iBits>>(64-have)):0;
+		iBits=0;
+		iCount=0;
+		UnderflowL();
+		return (val<<(aSize-have))|ReadL(aSize-have);
 	}
-
-#ifdef __CPU_X86
-	// X86 does not allow shift-by-32
-	iBits=aSize==32?0:bits<<aSize;
-#else
-	iBits=bits<<aSize;
-#endif
-
-	return val|(bits>>(32-aSize));
+	TUint val=TUint(iBits>>(64-aSize));
+	iBits<<=aSize;
+	iCount-=aSize;
+	return val;
 }
 
 /**
@@ -901,6 +1058,67 @@ TUint TBitInput::HuffmanL(const TUint32* aTree)
 	return huff>>17;
 }
 
+/**
+Read and decode a Huffman Code
+
+Interpret the next bits in the input as a Huffman code in the specified decoding.
+The decoding table should be the output from Huffman::Decoding().
+
+@param "const THuffmanTable& aTable" The huffman decoding table
+
+@return The symbol that was decoded
+
+@leave "UnderflowL()" It the bit stream is exhausted more UnderflowL is called to get more
+data
+*/
+TUint TBitInput::HuffmanL(const THuffmanTable& aTable)
+{
+	if (iCount<Huffman::KMaxCodeLength)
+		Refill();
+	const TUint32* entries=&aTable.iEntries[0];
+	TUint32 e=entries[iBits>>(64-THuffmanTable::KRootBits)];
+	if (e&THuffmanTable::KSubTable)
+	{
+		TInt bits=e&THuffmanTable::KLengthMask;
+		e=entries[((e&~THuffmanTable::KSubTable)>>THuffmanTable::KLengthBits)+
+			TUint((iBits<<THuffmanTable::KRootBits)>>(64-bits))];
+	}
+	TInt len=e&THuffmanTable::KLengthMask;
+	if (len==0 || len>iCount)
+		return HuffmanBitwiseL(aTable);	// near the end of the buffer or invalid code
+	iBits<<=len;
+	iCount-=len;
+	return e>>THuffmanTable::KLengthBits;
+}
+
+/**
+Decode a Huffman Code one bit at a time
+
+Used by HuffmanL() when the code may cross the end of the input buffer.
+*/
+TUint TBitInput::HuffmanBitwiseL(const THuffmanTable& aTable)
+{
+	if (aTable.iSymbols.size()==1)
+	{
+		ReadL();
+		return aTable.iSymbols[0];
+	}
+	TInt code=0;	// code read so far
+	TInt first=0;	// first code of the current length
+	TInt index=0;	// canonical index of the first code of the current length
+	for (TInt len=1;len<=Huffman::KMaxCodeLength;++len)
+	{
+		code|=ReadL();
+		TInt count=aTable.iCounts[len];
+		if (code-first<count)
+			return aTable.iSymbols[index+code-first];
+		index+=count;
+		first=(first+count)<<1;
+		code<<=1;
+	}
+	throw Elf2e32Error(HUFFMANINVALIDCODINGERROR);
+}
+
 #endif
 
 /**
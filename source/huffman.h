@@ -23,6 +23,9 @@
 
 #include <portable.h>
 #include <fstream>
+#include <vector>
+
+struct THuffmanTable;
 
 /** Bit output stream.
 	Good for writing bit streams for packed, compressed or huffman data algorithms.
@@ -44,10 +47,11 @@ class TBitOutput
 		virtual ~TBitOutput() = default;
 	private:
 		void DoWriteL(TUint aBits, TInt aSize);
+		inline void WriteByteL(TUint8 aByte);
 		virtual void OverflowL();
 	private:
-		TUint iCode;		// code in production
-		TInt iBits;
+		TUint64 iCode;		// code in production, from the most significant bit
+		TInt iBits;			// bits in iCode, less than 32 between calls
 		TUint8* iPtr;
 		TUint8* iEnd;
 };
@@ -80,13 +84,13 @@ inline const TUint8* TBitOutput::Ptr() const
 /**
 Get the number of bits that are buffered
 
-This reports the number of bits that have not yet been written into the output buffer.It will
-always lie in the range 0..7. Use PadL() to pad the data out to the next byte and write it to
-the buffer.
+This reports the number of bits that have not yet been written into the output buffer. It will
+always lie in the range 0..31 as the bits are written a word at a time. Use PadL() to pad the
+data out to the next byte and write it to the buffer.
 */
 inline TInt TBitOutput::BufferedBits() const
 {
-	return iBits+8;
+	return iBits;
 }
 
 /**
@@ -109,6 +113,23 @@ class TFileOutput : public TBitOutput
 		TUint8 iBuf[KBufSize];
 };
 
+/**
+This class is derived from TBitOutput, it writes into a memory buffer
+which grows as needed
+@internalComponent
+@released
+*/
+class TBufferOutput : public TBitOutput
+{
+	public:
+		explicit TBufferOutput(std::vector<TUint8>& aBuf);
+		TInt Size() const;
+	private:
+		void OverflowL();
+	private:
+		std::vector<TUint8>& iBuf;
+};
+
 /**
 Class for Bit input stream.
 Good for reading bit streams for packed, compressed or huffman data algorithms.
@@ -126,14 +147,17 @@ public:
     TUint ReadL();
     TUint ReadL(TInt aSize);
     TUint HuffmanL(const TUint32* aTree);
+    TUint HuffmanL(const THuffmanTable& aTable);
     virtual ~TBitInput();
 private:
+    inline void Refill();
+    TUint HuffmanBitwiseL(const THuffmanTable& aTable);
     virtual void UnderflowL();
 private:
-    TInt iCount;
-    TUint iBits;
-    TInt iRemain;
-    const TUint32* iPtr;
+    TInt iCount;		// valid bits in iBits
+    TUint64 iBits;		// next bits of the stream, starting from the most significant one
+    TInt iRemain;		// bits of the stream at iPtr not loaded into iBits
+    const TUint8* iPtr;
 };
 
 /**
@@ -153,6 +177,25 @@ class TFileInput : public TBitInput
 		TInt iSize;
 };
 
+/**
+Class derived from TBitInput, reads the compressed data from a stream through
+a window of fixed size, so the whole data never has to be in memory
+@internalComponent
+@released
+*/
+class TStreamInput : public TBitInput
+{
+	public:
+		TStreamInput(std::istream& aStream,TInt aSize,TInt aWindow);
+		virtual ~TStreamInput();
+	private:
+		void UnderflowL();
+	private:
+		std::istream& iStream;
+		TInt iLeft;		// bytes of the stream not read yet
+		std::vector<TUint8> iWindow;
+};
+
 /*
 Class for Huffman code toolkit.
 
@@ -183,9 +226,32 @@ class Huffman
 		static bool IsValid(const TUint32 aHuffman[],TInt aNumCodes);
 		static void ExternalizeL(TBitOutput& aOutput,const TUint32 aHuffman[],TInt aNumCodes);
 		static void Decoding(const TUint32 aHuffman[],TInt aNumCodes,TUint32 aDecodeTree[],TInt aSymbolBase=0);
+		static void Decoding(const TUint32 aHuffman[],TInt aNumCodes,THuffmanTable& aTable,TInt aSymbolBase=0);
 		static void InternalizeL(TBitInput& aInput,TUint32 aHuffman[],TInt aNumCodes);
 };
 
+/**
+Lookup table for decoding of a canonical huffman code, built by Huffman::Decoding().
+
+Codes up to KRootBits long are resolved by a single probe of the root table, longer
+codes take a second probe in a sub-table which follows the root table in iEntries.
+An entry holds the symbol and code length, or the sub-table offset and index width
+with KSubTable flag.
+@internalComponent
+@released
+*/
+struct THuffmanTable
+{
+	enum {KRootBits=10};
+	enum {KLengthBits=5, KLengthMask=(1<<KLengthBits)-1};
+	static const TUint32 KSubTable=0x80000000u;
+
+	std::vector<TUint32> iEntries;
+	// codes of each length and symbols in canonical order for bit by bit decoding
+	TUint16 iCounts[Huffman::KMaxCodeLength+1];
+	std::vector<TUint32> iSymbols;
+};
+
 // local definitions used for Huffman code generation
 typedef TUint16 THuff;		/** @internal */
 const THuff KLeaf=0x8000;	/** @internal */
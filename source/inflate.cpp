@@ -19,6 +19,7 @@
 //
 
 #include "inflate.h"
+#include <functional>
 #include "memory.h"
 #include "errorhandler.h"
 
@@ -43,7 +44,6 @@ void CInflater::ConstructL()
 	iEncoding=new TEncoding;
 	InitL();
 	iLen=0;
-	iOut=new TUint8[KDeflateMaxDistance];
 	iAvail=iLimit=iOut;
 }
 
@@ -103,6 +103,8 @@ TInt CInflater::ReadL(TUint8* aBuffer,TInt aLength)
 		tfr+=len;
 		if (aLength==0)
 			return tfr;
+		if (!iOut)
+			iOut=new TUint8[KDeflateMaxDistance];
 		len=InflateL();
 		if (len==0)
 			return tfr;
@@ -111,6 +113,80 @@ TInt CInflater::ReadL(TUint8* aBuffer,TInt aLength)
 	}
 }
 
+/*
+Function ReadDirectL
+Decode the stream straight into aBuffer. The output written so far serves as the history
+for distance codes, so no circular buffer and no copying are needed. The whole output must
+be read by one call, this can't be mixed with ReadL().
+@Leave
+@param aBuffer
+@param aLength
+@return the number of bytes decoded, less than aLength only if the end of stream marker was read
+@internalComponent
+@released
+*/
+TInt CInflater::ReadDirectL(TUint8* aBuffer,TInt aLength)
+{
+	TUint8* out=aBuffer;
+	TUint8* const end=out+aLength;
+	const THuffmanTable* table=&iLitLenTable;
+	if (iLen<0)	// EOF
+		return 0;
+
+	while (out<end)
+	{
+		TInt val=iBits->HuffmanL(*table)-TEncoding::ELiterals;
+		if (val<0)
+		{
+			*out++=TUint8(val);
+			continue;			// another literal/length combo
+		}
+		if (val==TEncoding::EEos-TEncoding::ELiterals)
+		{	// eos marker. we're done
+			iLen=-1;
+			break;
+		}
+
+		// get the extra bits for the code
+		TInt code=val&0xff;
+		if (code>=8)
+		{	// xtra bits
+			TInt xtra=(code>>2)-1;
+			code-=xtra<<2;
+			code<<=xtra;
+			code|=iBits->ReadL(xtra);
+		}
+		if (val<KDeflateDistCodeBase-TEncoding::ELiterals)
+		{	// length code... get the code
+			iLen=code+KDeflateMinLength;
+			table=&iDistanceTable;
+			continue;			// read the huffman code
+		}
+		// distance code, the match must lie in the output already written
+		if (code>=out-aBuffer)
+			throw Elf2e32Error(HUFFMANINVALIDCODINGERROR);
+		const TUint8* from=out-(code+1);
+		TInt tfr=iLen;
+		if (tfr>end-out)
+			tfr=end-out;
+		if (tfr<=code+1)
+		{
+			memcpy(out,from,tfr);
+			out+=tfr;
+		}
+		else
+		{	// the match overlaps itself and repeats the last code+1 bytes
+			do
+			{
+				*out++=*from++;
+			} while (--tfr!=0);
+		}
+		iLen=0;
+		table=&iLitLenTable;
+	}
+	return out-aBuffer;
+}
+
 /*
 Function InitL
 @Leave
@@ -128,9 +204,9 @@ void CInflater::InitL()
 		throw Elf2e32Error(HUFFMANINVALIDCODINGERROR);
 	}
 
-	// convert the length tables into huffman decoding trees
-	Huffman::Decoding(iEncoding->iLitLen,TEncoding::ELitLens,iEncoding->iLitLen);
-	Huffman::Decoding(iEncoding->iDistance,TEncoding::EDistances,iEncoding->iDistance,KDeflateDistCodeBase);
+	// convert the length tables into huffman decoding tables
+	Huffman::Decoding(iEncoding->iLitLen,TEncoding::ELitLens,iLitLenTable);
+	Huffman::Decoding(iEncoding->iDistance,TEncoding::EDistances,iDistanceTable,KDeflateDistCodeBase);
 }
 
 /*
@@ -145,7 +221,7 @@ TInt CInflater::InflateL()
 	// empty the history buffer into the output
 	TUint8* out=iOut;
 	TUint8* const end=out+KDeflateMaxDistance;
-	const TUint32* tree=iEncoding->iLitLen;
+	const THuffmanTable* table=&iLitLenTable;
 	if (iLen<0)	// EOF
 		return 0;
 	if (iLen>0)
@@ -155,7 +231,7 @@ TInt CInflater::InflateL()
 	{
 		// get a huffman code
 		{
-			TInt val=iBits->HuffmanL(tree)-TEncoding::ELiterals;
+			TInt val=iBits->HuffmanL(*table)-TEncoding::ELiterals;
 			if (val<0)
 			{
 				*out++=TUint8(val);
@@ -179,7 +255,7 @@ TInt CInflater::InflateL()
 			if (val<KDeflateDistCodeBase-TEncoding::ELiterals)
 			{	// length code... get the code
 				iLen=code+KDeflateMinLength;
-				tree=iEncoding->iDistance;
+				table=&iDistanceTable;
 				continue;			// read the huffman code
 			}
 			// distance code
@@ -203,7 +279,7 @@ TInt CInflater::InflateL()
 					from-=KDeflateMaxDistance;
 			}while (--tfr!=0);
 			iRptr=from;
-			tree=iEncoding->iLitLen;
+			table=&iLitLenTable;
 	};
 
 	return out-iOut;
@@ -242,21 +318,115 @@ void TFileInput::UnderflowL()
 	throw Elf2e32Error(HUFFMANBUFFERUNDERFLOWERROR);
 }
 
+/*
+TStreamInput Constructor
+@param aStream - stream positioned at the compressed data
+@param aSize - size of compressed data
+@param aWindow - size of the buffer for compressed data
+@internalComponent
+@released
+*/
+TStreamInput::TStreamInput(std::istream& aStream,TInt aSize,TInt aWindow):
+	iStream(aStream),iLeft(aSize),iWindow(aWindow)
+{
+}
+
+/*
+TStreamInput Destructor
+@internalComponent
+@released
+*/
+TStreamInput::~TStreamInput()
+{
+
+}
+
+/*
+Function UnderFlowL
+Read the next window of compressed data from the stream
+@Leave CommonError
+@internalComponent
+@released
+*/
+void TStreamInput::UnderflowL()
+{
+	TInt size=iLeft<(TInt)iWindow.size()?iLeft:(TInt)iWindow.size();
+	if (size<=0)
+		throw Elf2e32Error(HUFFMANBUFFERUNDERFLOWERROR);
+	iStream.read(reinterpret_cast<char *>(iWindow.data()),size);
+	if (iStream.gcount()!=size)
+		throw Elf2e32Error(HUFFMANBUFFERUNDERFLOWERROR);
+	iLeft-=size;
+	Set(iWindow.data(),size*8);
+}
+
+/*
+Function InflateStream
+Inflate the compressed data from the stream piece by piece, no more than a window
+of compressed and of decompressed data is held in memory
+@param aStream - stream positioned at the compressed data
+@param aSize - size of compressed data
+@param aDestSize - size of decompressed data
+@param aWindow - size of the buffers
+@param aSink - receives the decompressed data in order
+@return the number of bytes decompressed
+@internalComponent
+@released
+*/
+int InflateStream(std::istream& aStream, int aSize, int aDestSize, int aWindow,
+		const std::function<void(const unsigned char*, int)>& aSink)
+{
+	TStreamInput input(aStream, aSize, aWindow);
+	CInflater* inflater=CInflater::NewLC(input);
+	std::vector<TUint8> out(aWindow);
+	TInt total=0;
+	try
+	{
+		while (total<aDestSize)
+		{
+			TInt want=aDestSize-total<aWindow?aDestSize-total:aWindow;
+			TInt size=inflater->ReadL(out.data(),want);
+			if (size)
+				aSink(out.data(),size);
+			total+=size;
+			if (size<want)
+				break;
+		}
+	}
+	catch(...)
+	{
+		delete inflater;
+		throw;
+	}
+	delete inflater;
+	return total;
+}
+
 /*
 Function InflateUncompress
 @param source
 @param sourcesize
 @param dest
 @param destsize
+@return the number of bytes written to dest
 @internalComponent
 @released
 */
-void InflateUnCompress(unsigned char* source, int sourcesize,unsigned char* dest, int destsize)
+TInt InflateUnCompress(unsigned char* source, int sourcesize,unsigned char* dest, int destsize)
 {
-	TFileInput* input = new TFileInput(source, sourcesize);
-	CInflater* inflater=CInflater::NewLC(*input);
-	inflater->ReadL(dest,destsize);
-	delete input;
+	TFileInput input(source, sourcesize);
+	CInflater* inflater=CInflater::NewLC(input);
+	TInt size;
+	try
+	{
+		size=inflater->ReadDirectL(dest,destsize);
+	}
+	catch(...)
+	{
+		delete inflater;
+		throw;
+	}
 	delete inflater;
+	return size;
 }
 
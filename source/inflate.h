@@ -38,6 +38,7 @@ class CInflater
 		static CInflater* NewLC(TBitInput& aInput);
 		~CInflater();
 		TInt ReadL(TUint8* aBuffer,TInt aLength);
+		TInt ReadDirectL(TUint8* aBuffer,TInt aLength);
 		TInt SkipL(TInt aLength);
 	private:
 		CInflater(TBitInput& aInput);
@@ -51,6 +52,8 @@ class CInflater
 		const TUint8* iAvail;			// available data
 		const TUint8* iLimit;
 		TEncoding* iEncoding;
+		THuffmanTable iLitLenTable;		// decoding tables built from iEncoding
+		THuffmanTable iDistanceTable;
 		TUint8* iOut;					// circular buffer for distance matches
 		TUint8 iHuff[EBufSize+ESafetyZone];	// huffman data
 };
@@ -0,0 +1,264 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Implementation of the Class LibPathIndex for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#include <random>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "libpathindex.h"
+
+using std::string;
+using std::vector;
+
+static const char KIndexHeader[] = "elf2e32 libpath index 1";
+
+/**
+File names are compared without case on Windows, so they are stored lowercase
+there.
+*/
+static string NameKey(const string& aName)
+{
+#if defined(_WIN32)
+    string key(aName);
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    return key;
+#else
+    return aName;
+#endif
+}
+
+/**
+Function returns the index of the current process.
+@internalComponent
+@released
+*/
+LibPathIndex *LibPathIndex::GetInstance()
+{
+    static LibPathIndex iIndex;
+    return &iIndex;
+}
+
+/**
+Function sets the file to keep the listings in between runs, empty to keep
+them in memory only.
+@param aFile - index file
+@internalComponent
+@released
+*/
+void LibPathIndex::SetIndexFile(const string& aFile)
+{
+    std::lock_guard<std::mutex> guard(iLock);
+    iIndexFile = aFile;
+    iLoaded = false;
+}
+
+/**
+Function finds the directory that has the file. If several directories contain
+it the first one wins, as with probing them in turn, and a warning is shown
+once per name.
+@param aPaths - directories in search order
+@param aName - file name
+@return directory that has the file or empty string if none has it
+@internalComponent
+@released
+*/
+string LibPathIndex::Find(const vector<string>& aPaths, const string& aName)
+{
+    std::lock_guard<std::mutex> guard(iLock);
+    if(!iLoaded)
+        Load();
+
+    string key = NameKey(aName);
+    vector<const string*> found;
+    for(const auto& dir: aPaths)
+    {
+        if(GetListing(dir).iNames.count(key))
+            found.push_back(&dir);
+    }
+    if(iDirty)
+        Save();
+
+    if(found.empty())
+        return string();
+    if(found.size() > 1 && iReported.insert(key).second)
+    {
+        std::cout << "Elf2e32: Warning: DSO " << aName << " found in several library paths, using "
+            << *found[0] << "\n";
+        for(size_t i = 1; i < found.size(); i++)
+            std::cout << "\talso in " << *found[i] << "\n";
+    }
+    return *found[0];
+}
+
+/**
+Function returns the listing of the directory, listing it if this process
+has not checked it yet and the stored one is out of date.
+@internalComponent
+@released
+*/
+const LibPathIndex::Listing& LibPathIndex::GetListing(const string& aDir)
+{
+    Listing& listing = iListings[aDir];
+    if(iChecked.insert(aDir).second)
+    {
+        struct stat st;
+        int64_t modified = (stat(aDir.c_str(), &st) == 0) ? (int64_t)st.st_mtime : -1;
+        if(modified < 0 || modified != listing.iModified)
+        {
+            listing.iNames.clear();
+            listing.iModified = modified;
+            if(modified >= 0)
+                ListDir(aDir, listing);
+            iDirty = true;
+        }
+    }
+    return listing;
+}
+
+/**
+Function reads the names of the regular files in the directory
+@internalComponent
+@released
+*/
+bool LibPathIndex::ListDir(const string& aDir, Listing& aListing)
+{
+#if defined(_WIN32)
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA((aDir + "\\*").c_str(), &data);
+    if(h == INVALID_HANDLE_VALUE)
+        return false;
+    do
+    {
+        if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            aListing.iNames.insert(NameKey(data.cFileName));
+    } while(FindNextFileA(h, &data));
+    FindClose(h);
+    return true;
+#else
+    DIR* d = opendir(aDir.c_str());
+    if(!d)
+        return false;
+    while(struct dirent* e = readdir(d))
+    {
+        if(e->d_type == DT_DIR)
+            continue;
+        aListing.iNames.insert(NameKey(e->d_name));
+    }
+    closedir(d);
+    return true;
+#endif
+}
+
+/**
+Function reads the stored listings. The file holds the header line, then for
+every directory a line "<mtime> <count> <directory>" and its file names one
+per line. A damaged file is ignored.
+@internalComponent
+@released
+*/
+void LibPathIndex::Load()
+{
+    iLoaded = true;
+    if(iIndexFile.empty())
+        return;
+    std::ifstream is(iIndexFile.c_str());
+    string line;
+    if(!std::getline(is, line) || line != KIndexHeader)
+        return;
+
+    std::map<string, Listing> listings;
+    while(std::getline(is, line))
+    {
+        std::istringstream dirLine(line);
+        Listing listing;
+        size_t count = 0;
+        string dir;
+        if(!(dirLine >> listing.iModified >> count) || !std::getline(dirLine >> std::ws, dir))
+            return;
+        for(size_t i = 0; i < count; i++)
+        {
+            if(!std::getline(is, line))
+                return;
+            listing.iNames.insert(line);
+        }
+        listings[dir].iModified = listing.iModified;
+        listings[dir].iNames.swap(listing.iNames);
+    }
+    for(auto& x: listings)
+    {
+        if(!iChecked.count(x.first))
+            iListings[x.first] = x.second;
+    }
+}
+
+/**
+Function stores the listings. They are written to a unique temporary file
+renamed over the index file, so concurrent runs never read a partial index.
+Failures are ignored, the index only saves time.
+@internalComponent
+@released
+*/
+void LibPathIndex::Save()
+{
+    iDirty = false;
+    if(iIndexFile.empty())
+        return;
+
+    std::random_device rd;
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", rd(), rd());
+    string tmp = iIndexFile + suffix;
+    {
+        std::ofstream os(tmp.c_str(), std::ofstream::trunc);
+        if(!os)
+            return;
+        os << KIndexHeader << "\n";
+        for(const auto& x: iListings)
+        {
+            if(x.second.iModified < 0)
+                continue;
+            os << x.second.iModified << " " << x.second.iNames.size() << " " << x.first << "\n";
+            for(const auto& name: x.second.iNames)
+                os << name << "\n";
+        }
+        if(!os)
+        {
+            os.close();
+            remove(tmp.c_str());
+            return;
+        }
+    }
+    if(rename(tmp.c_str(), iIndexFile.c_str()) != 0)
+    {
+        remove(iIndexFile.c_str());
+        if(rename(tmp.c_str(), iIndexFile.c_str()) != 0)
+            remove(tmp.c_str());
+    }
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Class LibPathIndex lists the library search paths for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#ifndef LIBPATHINDEX_H
+#define LIBPATHINDEX_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_set>
+
+/**
+File names in the --libpath directories. Each directory is listed once per
+process, so finding a DSO is a lookup instead of an open() per directory.
+With SetIndexFile() the listings are kept in a file and reused by later runs
+while the directory modification time stays the same.
+All functions are safe to call from several threads.
+@internalComponent
+@released
+*/
+class LibPathIndex
+{
+    public:
+        static LibPathIndex *GetInstance();
+
+        void SetIndexFile(const std::string& aFile);
+        std::string Find(const std::vector<std::string>& aPaths, const std::string& aName);
+    private:
+        /** Names of the files in a directory, at the given modification time */
+        struct Listing
+        {
+            int64_t iModified = -1;
+            std::unordered_set<std::string> iNames;
+        };
+
+        const Listing& GetListing(const std::string& aDir);
+        bool ListDir(const std::string& aDir, Listing& aListing);
+        void Load();
+        void Save();
+    private:
+        std::mutex iLock;
+        std::string iIndexFile;
+        bool iLoaded = false;
+        bool iDirty = false;
+        /** Listings by directory, those checked in this process are in iChecked */
+        std::map<std::string, Listing> iListings;
+        std::unordered_set<std::string> iChecked;
+        /** DSO names already reported as found in several directories */
+        std::unordered_set<std::string> iReported;
+};
+
+#endif // LIBPATHINDEX_H
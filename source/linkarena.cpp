@@ -0,0 +1,160 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Implementation of the Class LinkArena for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#include <new>
+#include <cstring>
+
+#include "linkarena.h"
+
+static const size_t KArenaBlockSize = 0x10000;
+static const size_t KArenaAlign = alignof(std::max_align_t);
+
+static size_t AlignSize(size_t aSize)
+{
+    return (aSize + KArenaAlign - 1) & ~(KArenaAlign - 1);
+}
+
+/**
+Function returns the arena of the current link.
+@internalComponent
+@released
+*/
+LinkArena *LinkArena::GetInstance()
+{
+    static LinkArena iArena;
+    return &iArena;
+}
+
+LinkArena::LinkArena() {}
+
+LinkArena::~LinkArena()
+{
+    for(auto b: iBlocks)
+        delete[] b;
+}
+
+void* LinkArena::AllocateLocked(size_t aSize)
+{
+    aSize = AlignSize(aSize ? aSize : 1);
+    if(aSize > iLeft)
+    {
+        // big requests get a block of their own and keep the current one
+        if(aSize > KArenaBlockSize / 4)
+        {
+            char* b = new char[aSize];
+            iBlocks.push_back(b);
+            return b;
+        }
+        iFree = new char[KArenaBlockSize];
+        iLeft = KArenaBlockSize;
+        iBlocks.push_back(iFree);
+    }
+    void* p = iFree;
+    iFree += aSize;
+    iLeft -= aSize;
+    return p;
+}
+
+/**
+Function allocates memory which stays valid until the arena is destroyed
+@param aSize - number of bytes
+@return memory aligned for any type
+@internalComponent
+@released
+*/
+void* LinkArena::Allocate(size_t aSize)
+{
+    std::lock_guard<std::mutex> guard(iLock);
+    size_t units = AlignSize(aSize ? aSize : 1) / KArenaAlign;
+    if(units < iRecycled.size() && iRecycled[units])
+    {
+        void* p = iRecycled[units];
+        iRecycled[units] = *(void**)p;
+        return p;
+    }
+    return AllocateLocked(aSize);
+}
+
+/**
+Function takes back memory from Allocate() to serve the next request of the same size
+@param aPtr - memory returned by Allocate()
+@param aSize - size passed to Allocate()
+@internalComponent
+@released
+*/
+void LinkArena::Recycle(void* aPtr, size_t aSize)
+{
+    if(!aPtr)
+        return;
+    std::lock_guard<std::mutex> guard(iLock);
+    size_t units = AlignSize(aSize ? aSize : 1) / KArenaAlign;
+    if(units >= iRecycled.size())
+        iRecycled.resize(units + 1, nullptr);
+    *(void**)aPtr = iRecycled[units];
+    iRecycled[units] = aPtr;
+}
+
+/**
+Function returns the single arena copy of the string
+@param aStr - zero terminated string
+@return zero terminated copy, the same pointer for equal strings
+@internalComponent
+@released
+*/
+const char* LinkArena::Intern(const char* aStr)
+{
+    return Intern(aStr, strlen(aStr));
+}
+
+/**
+Function returns the single arena copy of the string
+@param aStr - string, may be not zero terminated
+@param aLength - length of the string
+@return zero terminated copy, the same pointer for equal strings
+@internalComponent
+@released
+*/
+const char* LinkArena::Intern(const char* aStr, size_t aLength)
+{
+    std::lock_guard<std::mutex> guard(iLock);
+    Key key = {aStr, aLength};
+    auto it = iStrings.find(key);
+    if(it != iStrings.end())
+        return it->iStr;
+
+    char* copy = (char*)AllocateLocked(aLength + 1);
+    memcpy(copy, aStr, aLength);
+    copy[aLength] = 0;
+    key.iStr = copy;
+    iStrings.insert(key);
+    return copy;
+}
+
+bool LinkArena::Key::operator==(const Key& aKey) const
+{
+    return iLength == aKey.iLength && !memcmp(iStr, aKey.iStr, iLength);
+}
+
+size_t LinkArena::KeyHash::operator()(const Key& aKey) const
+{
+    size_t h = 2166136261u;
+    for(size_t i = 0; i < aKey.iLength; i++)
+        h = (h ^ (unsigned char)aKey.iStr[i]) * 16777619u;
+    return h;
+}
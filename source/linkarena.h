@@ -0,0 +1,75 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Class LinkArena provides bulk memory and interned strings for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#ifndef LINKARENA_H
+#define LINKARENA_H
+
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <unordered_set>
+
+/**
+Memory that lives as long as the link: symbols and their names.
+Allocate() hands out memory from large blocks which are only freed together,
+Intern() keeps a single copy of every string so equal names share storage.
+Fixed size objects may be given back with Recycle() for reuse.
+All functions are safe to call from several threads.
+@internalComponent
+@released
+*/
+class LinkArena
+{
+    public:
+        static LinkArena *GetInstance();
+
+        LinkArena();
+        ~LinkArena();
+
+        void* Allocate(size_t aSize);
+        void Recycle(void* aPtr, size_t aSize);
+        const char* Intern(const char* aStr);
+        const char* Intern(const char* aStr, size_t aLength);
+    private:
+        LinkArena(const LinkArena&) = delete;
+        LinkArena& operator=(const LinkArena&) = delete;
+
+        void* AllocateLocked(size_t aSize);
+
+        struct Key
+        {
+            const char* iStr;
+            size_t iLength;
+            bool operator==(const Key& aKey) const;
+        };
+        struct KeyHash
+        {
+            size_t operator()(const Key& aKey) const;
+        };
+    private:
+        std::mutex iLock;
+        std::vector<char*> iBlocks;
+        char* iFree = nullptr;
+        size_t iLeft = 0;
+        /** Heads of the lists of recycled objects, one per size in alignment units */
+        std::vector<void*> iRecycled;
+        std::unordered_set<Key, KeyHash> iStrings;
+};
+
+#endif // LINKARENA_H
@@ -19,10 +19,13 @@
 #include <stdlib.h>
 #include <memory.h>
 
+#include <vector>
 #include <fstream>
 #include <sstream>
 
 #include "byte_pair.h"
+#include "workerpool.h"
+#include "pagedcompress.h"
 
 #define PAGE_SIZE 4096
 
@@ -53,18 +56,19 @@ class CBytePairCompressedImage
 		~CBytePairCompressedImage();
 
 		void AddPage(TUint16 aPageNum, TUint8 * aPageData, TUint16 aPageSize);
-		int  GetPage(TUint16 aPageNum, TUint8 * aPageData);
-		void WriteOutTable(std::ofstream &os);
-		int  ReadInTable(std::ifstream &is, TUint & aNumberOfPages);
+		void AddPages(TUint8 * aBytes, TInt aSize, CompressionLevel aLevel);
+		void WriteOutTable(std::ostream &os);
 
 	private:
 		TInt ConstructL( TUint16 aNumberOfPages, TInt aSize);
 		CBytePairCompressedImage();
+		void CompressPage(TUint16 aPageNum, TUint8 * aPageData, TUint16 aPageSize, BytePairContext & aContext,
+				CompressionLevel aLevel = ECompressionNormal);
 
 	private:
 		IndexTableHeader 	iHeader;
 		IndexTableItem*		iPages;
-		TUint8* 			iOutBuffer;
+		BytePairContext*	iContext = nullptr;
 };
 
 
@@ -108,12 +112,6 @@ TInt CBytePairCompressedImage::ConstructL(TUint16 aNumberOfPages, TInt aSize)
 							sizeof(iHeader.iNumberOfPages) +
 							aNumberOfPages * sizeof(TUint16);
 
-	iOutBuffer = (TUint8 *) calloc(4 * PAGE_SIZE, sizeof(TUint8) );
-
-	if ( nullptr == iOutBuffer)
-	{
-		return KErrNoMemory;
-	}
 	return KErrNone;
 } // End of ConstructL()
 
@@ -129,15 +127,51 @@ CBytePairCompressedImage::~CBytePairCompressedImage()
 	free( iPages );
 	iPages = nullptr;
 
-	free( iOutBuffer );
-	iOutBuffer = nullptr;
+	delete iContext;
+	iContext = nullptr;
 }
 
 
 void CBytePairCompressedImage::AddPage(TUint16 aPageNum, TUint8 * aPageData, TUint16 aPageSize)
 {
 	//Print(EWarning,"Start of AddPage(aPageNum:%d, ,aPageSize:%d)\n",aPageNum, aPageSize );
+	if( nullptr == iContext )
+	{
+		iContext = new BytePairContext;
+	}
+	CompressPage(aPageNum, aPageData, aPageSize, *iContext);
+	iHeader.iSizeOfData += iPages[aPageNum].iSizeOfCompressedPageData;
+}
 
+/**
+Function compresses all pages of the image on the shared WorkerPool.
+Every page packed to its own slot in iPages, so the result doesn't depend on
+the number of workers and matches the serial AddPage() sequence byte for byte.
+Each worker packs its pages with own BytePairContext.
+@internalComponent
+@released
+*/
+void CBytePairCompressedImage::AddPages(TUint8 * aBytes, TInt aSize, CompressionLevel aLevel)
+{
+	WorkerPool *pool = WorkerPool::GetInstance();
+	std::vector<BytePairContext> contexts(pool->Workers());
+
+	pool->ParallelFor(iHeader.iNumberOfPages, [&](size_t aPage, size_t aWorker)
+	{
+		TUint offset = aPage * PAGE_SIZE;
+		TUint pageLen = (TUint)aSize - offset;
+		if(pageLen > PAGE_SIZE)
+			pageLen = PAGE_SIZE;
+		CompressPage((TUint16)aPage, aBytes + offset, (TUint16)pageLen, contexts[aWorker], aLevel);
+	});
+
+	for(TInt i = 0; i < iHeader.iNumberOfPages; i++)
+		iHeader.iSizeOfData += iPages[i].iSizeOfCompressedPageData;
+}
+
+void CBytePairCompressedImage::CompressPage(TUint16 aPageNum, TUint8 * aPageData, TUint16 aPageSize, BytePairContext & aContext,
+		CompressionLevel aLevel)
+{
 #ifdef __TEST_ONLY__
 
 	iPages[aPageNum].iSizeOfCompressedPageData = 2;
@@ -149,7 +183,12 @@ void CBytePairCompressedImage::AddPage(TUint16 aPageNum, TUint8 * aPageData, TUi
 
 #else
 
-	TUint16 compressedSize = (TUint16) Pak(iOutBuffer,aPageData,aPageSize );
+	TUint8 * outBuffer = aContext.iPakBuffer;
+	TUint16 compressedSize;
+	if(aLevel == ECompressionMax)
+		compressedSize = (TUint16) PakMax(aContext, outBuffer, aPageData, aPageSize );
+	else
+		compressedSize = (TUint16) Pak(aContext, outBuffer, aPageData, aPageSize );
 	iPages[aPageNum].iSizeOfCompressedPageData = compressedSize;
 	//Print(EWarning,"Compressed page size:%d\n", iPages[aPageNum].iSizeOfCompressedPageData );
 
@@ -160,14 +199,12 @@ void CBytePairCompressedImage::AddPage(TUint16 aPageNum, TUint8 * aPageData, TUi
 		return;
 	}
 
-	memcpy(iPages[aPageNum].iCompressedPageData, iOutBuffer, iPages[aPageNum].iSizeOfCompressedPageData );
+	memcpy(iPages[aPageNum].iCompressedPageData, outBuffer, iPages[aPageNum].iSizeOfCompressedPageData );
 
 #endif
-
-	iHeader.iSizeOfData += iPages[aPageNum].iSizeOfCompressedPageData;
 }
 
-void CBytePairCompressedImage::WriteOutTable(std::ofstream & os)
+void CBytePairCompressedImage::WriteOutTable(std::ostream & os)
 {
 	// Write out IndexTableHeader
 	//Print(EWarning,"Write out IndexTableHeader(iSizeOfData:%d,iDecompressedSize:%d,iNumberOfPages:%d)\n",iHeader.iSizeOfData, iHeader.iDecompressedSize, iHeader.iNumberOfPages );
@@ -192,115 +229,243 @@ void CBytePairCompressedImage::WriteOutTable(std::ofstream & os)
 }
 
 
-int CBytePairCompressedImage::ReadInTable(std::ifstream &is, TUint & aNumberOfPages)
+void CompressPages(TUint8* bytes, TInt size, std::ostream& os, CompressionLevel level)
 {
-	// Read page index table header
-	is.read((char *)&iHeader, (sizeof(iHeader.iSizeOfData)+sizeof(iHeader.iDecompressedSize)+sizeof(iHeader.iNumberOfPages)));
-
-	// Allocatin place to Page index table entries
-	iPages = (IndexTableItem *) calloc(iHeader.iNumberOfPages, sizeof(IndexTableItem));
+	// Build a list of compressed pages
+	TUint16 numOfPages = (TUint16) ((size + PAGE_SIZE - 1) / PAGE_SIZE);
 
-	if( nullptr == iPages )
+	CBytePairCompressedImage* comprImage = CBytePairCompressedImage::NewLC(numOfPages, size);
+	if (!comprImage)
 	{
-		return KErrNoMemory;
+		//Print(EError," NULL == comprImage\n");
+		return;
 	}
 
-	// Read whole Page index table
+	comprImage->AddPages(bytes, size, level);
 
-	for(TInt i = 0; i < iHeader.iNumberOfPages; i++)
-	{
-		is.read((char *) &(iPages[i].iSizeOfCompressedPageData), sizeof(TUint16));
-	}
+	// Write out index table and compressed pages
+	comprImage->WriteOutTable(os);
 
-	// Read compressed data pages page by page, decompress and store them
-	for(TInt i = 0; i < iHeader.iNumberOfPages; i++)
-	{
+	delete comprImage;
+	comprImage = nullptr;
+}
 
-		iPages[i].iCompressedPageData = (TUint8 *) calloc(iPages[i].iSizeOfCompressedPageData, sizeof(TUint8) );
 
-		if( nullptr == iPages[i].iCompressedPageData )
-		{
-			return KErrNoMemory;
-		}
+void DeflateCompress(char *bytes, size_t size, std::ostream& os, CompressionLevel level);
 
-		is.read((char *)iPages[i].iCompressedPageData, iPages[i].iSizeOfCompressedPageData);
+uint32_t CompressBest(TUint8* bytes, TInt size, TInt codeSize, CompressionLevel level,
+		uint32_t margin, std::string& compressed)
+{
+	// each compressor spreads its pages or chunks over the WorkerPool already,
+	// so they run one after another to keep all workers busy
+	std::ostringstream deflated;
+	DeflateCompress((char*)bytes, size, deflated, level);
+
+	std::ostringstream paged;
+	CompressPages(bytes, codeSize, paged, level);
+	CompressPages(bytes + codeSize, size - codeSize, paged, level);
+
+	compressed = paged.str();
+	TUint64 inflateSize = deflated.tellp();
+	if(inflateSize * 100 < compressed.size() * (TUint64)(100 - margin))
+	{
+		compressed = deflated.str();
+		return KUidCompressionDeflate;
 	}
+	return KUidCompressionBytePair;
+}
 
-	aNumberOfPages = iHeader.iNumberOfPages;
+/**
+Function parses index table of paged compressed data.
+@param aSrc - index table followed by compressed pages
+@param aSrcSize - size of data available at aSrc
+@return KErrNone or KErrCorrupt if the table or pages don't fit into aSrcSize
+@internalComponent
+@released
+*/
+TInt BytePairPageIndex::Open(const TUint8* aSrc, TInt aSrcSize)
+{
+	// IndexTableHeader fields are stored without padding
+	const TInt headerSize = sizeof(TInt) + sizeof(TInt) + sizeof(TUint16);
+	if(aSrcSize < headerSize)
+		return KErrCorrupt;
+
+	TUint16 numberOfPages;
+	memcpy(&iDecompressedSize, aSrc + sizeof(TInt), sizeof(TInt));
+	memcpy(&numberOfPages, aSrc + 2 * sizeof(TInt), sizeof(TUint16));
+
+	const TUint8* sizes = aSrc + headerSize;
+	TUint offset = headerSize + numberOfPages * sizeof(TUint16);
+	if(offset > (TUint)aSrcSize)
+		return KErrCorrupt;
+
+	iOffsets.resize(numberOfPages + 1);
+	for(TInt i = 0; i < numberOfPages; i++)
+	{
+		TUint16 pageSize;
+		memcpy(&pageSize, sizes + i * sizeof(TUint16), sizeof(TUint16));
+		iOffsets[i] = offset;
+		offset += pageSize;
+	}
+	iOffsets[numberOfPages] = offset;
+	if(offset > (TUint)aSrcSize)
+		return KErrCorrupt;
 
+	iSrc = aSrc;
 	return KErrNone;
 }
 
-int  CBytePairCompressedImage::GetPage(TUint16 aPageNum, TUint8 * aPageData)
+TInt BytePairPageIndex::Pages() const
 {
-	TUint8* pakEnd;
-
-    const TInt MaxBlockSize = 0x1000;
+	return iOffsets.empty() ? 0 : iOffsets.size() - 1;
+}
 
-   	TUint16 uncompressedSize = (TUint16) Unpak( aPageData,
-												MaxBlockSize,
-												iPages[aPageNum].iCompressedPageData,
-												iPages[aPageNum].iSizeOfCompressedPageData,
-												pakEnd );
+TInt BytePairPageIndex::DecompressedSize() const
+{
+	return iDecompressedSize;
+}
 
-	return uncompressedSize;
+/** Size of index table and all compressed pages */
+TInt BytePairPageIndex::CompressedSize() const
+{
+	return iOffsets.empty() ? 0 : iOffsets.back();
 }
 
+/**
+Function unpacks single page.
+@param aPage - page number
+@param aDst - buffer for the page, PAGE_SIZE bytes is enough for any page
+@param aDstSize - size of buffer
+@return size of unpacked page or KErrCorrupt
+@internalComponent
+@released
+*/
+TInt BytePairPageIndex::GetPage(TInt aPage, TUint8* aDst, TInt aDstSize) const
+{
+	if(aPage < 0 || aPage >= Pages())
+		return KErrCorrupt;
+	if(aDstSize > PAGE_SIZE)
+		aDstSize = PAGE_SIZE;
+
+	TUint8* pakEnd;
+	return Unpak(aDst, aDstSize, (TUint8*)iSrc + iOffsets[aPage],
+				iOffsets[aPage + 1] - iOffsets[aPage], pakEnd);
+}
 
-void CompressPages(TUint8* bytes, TInt size, std::ofstream& os)
+/**
+Function unpacks only pages which cover range of decompressed data.
+@param aOffset - offset of range in decompressed data
+@param aSize - size of range
+@param aDst - buffer for aSize bytes
+@return number of bytes copied, less than aSize if range goes beyond the data, or KErrCorrupt
+@internalComponent
+@released
+*/
+TInt BytePairPageIndex::GetRange(TInt aOffset, TInt aSize, TUint8* aDst) const
 {
-	// Build a list of compressed pages
-	TUint16 numOfPages = (TUint16) ((size + PAGE_SIZE - 1) / PAGE_SIZE);
+	if(aOffset < 0 || aSize < 0)
+		return KErrCorrupt;
 
-	CBytePairCompressedImage* comprImage = CBytePairCompressedImage::NewLC(numOfPages, size);
-	if (!comprImage)
+	TUint8 page[PAGE_SIZE];
+	TInt copied = 0;
+	while(copied < aSize)
 	{
-		//Print(EError," NULL == comprImage\n");
-		return;
-	}
+		TInt pos = aOffset + copied;
+		TInt pageNum = pos / PAGE_SIZE;
+		if(pageNum >= Pages())
+			break;
+		TInt inPage = pos % PAGE_SIZE;
+		TInt want = aSize - copied;
+
+		// whole pages are unpacked in place
+		if(!inPage && want >= PAGE_SIZE)
+		{
+			TInt size = GetPage(pageNum, aDst + copied, PAGE_SIZE);
+			if(size < 0)
+				return KErrCorrupt;
+			copied += size;
+			if(size < PAGE_SIZE)
+				break;
+			continue;
+		}
 
-	TUint pageNum;
-	TUint remain = (TUint)size;
-	for (pageNum=0; pageNum<numOfPages; ++pageNum)
-	{
-		TUint8* pageStart = bytes + pageNum * PAGE_SIZE;
-		TUint pageLen = remain>PAGE_SIZE ? PAGE_SIZE : remain;
-		comprImage->AddPage((TUint16)pageNum, pageStart, (TUint16)pageLen);
-		remain -= pageLen;
+		TInt size = GetPage(pageNum, page, PAGE_SIZE);
+		if(size < 0)
+			return KErrCorrupt;
+		if(inPage >= size)
+			break;
+		TInt n = size - inPage;
+		if(n > want)
+			n = want;
+		memcpy(aDst + copied, page + inPage, n);
+		copied += n;
+		if(inPage + n < PAGE_SIZE && n < want)
+			break;
 	}
-
-	// Write out index table and compressed pages
-	comprImage->WriteOutTable(os);
-
-	delete comprImage;
-	comprImage = nullptr;
+	return copied;
 }
 
 
-int DecompressPages(TUint8 * bytes, std::ifstream& is)
+int32_t StreamPages(std::istream& is, TInt srcSize,
+		const std::function<void(const TUint8*, TInt)>& sink, TInt& srcUsed)
 {
-	CBytePairCompressedImage *comprImage = CBytePairCompressedImage::NewLC(0, 0);
-	if( nullptr == comprImage)
+	// IndexTableHeader fields are stored without padding
+	const TInt headerSize = sizeof(TInt) + sizeof(TInt) + sizeof(TUint16);
+	TUint8 header[headerSize];
+	if(srcSize < headerSize || !is.read((char*)header, headerSize))
+		return KErrCorrupt;
+
+	TUint16 numberOfPages;
+	memcpy(&numberOfPages, header + 2 * sizeof(TInt), sizeof(TUint16));
+	std::vector<TUint16> sizes(numberOfPages);
+	TInt used = headerSize + numberOfPages * sizeof(TUint16);
+	if(used > srcSize || !is.read((char*)sizes.data(), numberOfPages * sizeof(TUint16)))
+		return KErrCorrupt;
+
+	std::vector<TUint8> src;
+	TUint8 page[PAGE_SIZE];
+	TInt decompressedSize = 0;
+	for(TUint16 pageSize: sizes)
 	{
-		//Print(EError," NULL == comprImage\n");
-		return KErrNoMemory;
+		used += pageSize;
+		src.resize(pageSize);
+		if(used > srcSize || !is.read((char*)src.data(), pageSize))
+			return KErrCorrupt;
+		TUint8* pakEnd;
+		TInt size = Unpak(page, PAGE_SIZE, src.data(), pageSize, pakEnd);
+		if(size < 0)
+			return KErrCorrupt;
+		sink(page, size);
+		decompressedSize += size;
 	}
 
-	TUint numberOfPages = 0;
-	comprImage->ReadInTable(is, numberOfPages);
+	srcUsed = used;
+	return decompressedSize;
+}
 
-	TUint16 iPage = 0;
-	TUint decompressedSize = 0;
+int32_t DecompressPages(TUint8* bytes, TInt bytesSize, const TUint8* src, TInt srcSize, TInt& srcUsed)
+{
+	BytePairPageIndex index;
+	if(index.Open(src, srcSize) != KErrNone)
+		return KErrCorrupt;
 
-	while(iPage < numberOfPages )
+	// pages unpack independently into own slots of bytes on the shared WorkerPool
+	std::vector<TInt> sizes(index.Pages(), KErrCorrupt);
+	WorkerPool::GetInstance()->ParallelFor(sizes.size(), [&](size_t aPage, size_t)
 	{
-		TUint8* iPageStart = &bytes[iPage * PAGE_SIZE];
-
-		decompressedSize += comprImage->GetPage(iPage, iPageStart);
+		TInt room = bytesSize - (TInt)aPage * PAGE_SIZE;
+		if(room > 0)
+			sizes[aPage] = index.GetPage(aPage, bytes + aPage * PAGE_SIZE, room);
+	});
 
-		++iPage;
+	TInt decompressedSize = 0;
+	for(TInt size: sizes)
+	{
+		if(size < 0)
+			return KErrCorrupt;
+		decompressedSize += size;
 	}
 
-	delete comprImage;
+	srcUsed = index.CompressedSize();
 	return decompressedSize;
 }
@@ -0,0 +1,124 @@
+// Copyright (c) 2005-2009 Nokia Corporation and/or its subsidiary(-ies).
+// Copyright (c) 2017-2018 Strizhniou Fiodar.
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Nokia Corporation - initial contribution.
+//
+// Contributors: Strizhniou Fiodar - fix build and runtime errors.
+//
+// Description:
+// Interface of the paged byte pair compression for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#ifndef PAGEDCOMPRESS_H
+#define PAGEDCOMPRESS_H
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include <functional>
+#include <string>
+
+/**
+Effort of the image compressors, set by --compressionlevel option.
+Byte pair compression has no faster mode and treats ECompressionFast as ECompressionNormal.
+@internalComponent
+@released
+*/
+enum CompressionLevel
+{
+	ECompressionFast,
+	ECompressionNormal,
+	ECompressionMax
+};
+
+/**
+This function Paged Pack the compressed data.
+Pages are compressed independently on the shared WorkerPool.
+@param bytes
+@param size
+@param os
+@param level - ECompressionMax searches for the smallest encoding of each page
+@internalComponent
+@released
+*/
+void CompressPages(uint8_t* bytes, int32_t size, std::ostream& os, CompressionLevel level);
+
+/**
+This function compresses the image body with both inflate and bytepair
+for --compressionmethod=auto and keeps the smaller one.
+@param bytes - image body, code section first
+@param size - size of image body
+@param codeSize - size of code section
+@param level
+@param margin - bytepair is kept unless inflate is smaller by more than margin percent
+@param compressed - receives the compressed body
+@return UID of the chosen compression method
+@internalComponent
+@released
+*/
+uint32_t CompressBest(uint8_t* bytes, int32_t size, int32_t codeSize, CompressionLevel level,
+        uint32_t margin, std::string& compressed);
+
+/**
+Random access to pages of paged compressed data in memory.
+Offsets of the pages are computed once from the index table,
+so any page or byte range can be unpacked without touching other pages.
+@internalComponent
+@released
+*/
+class BytePairPageIndex
+{
+    public:
+        int32_t Open(const uint8_t* aSrc, int32_t aSrcSize);
+
+        int32_t Pages() const;
+        int32_t DecompressedSize() const;
+        int32_t CompressedSize() const;
+
+        int32_t GetPage(int32_t aPage, uint8_t* aDst, int32_t aDstSize) const;
+        int32_t GetRange(int32_t aOffset, int32_t aSize, uint8_t* aDst) const;
+    private:
+        const uint8_t* iSrc = nullptr;
+        // offset of every page from iSrc and end of the last page
+        std::vector<uint32_t> iOffsets;
+        int32_t iDecompressedSize = 0;
+};
+
+/**
+This function unpacks paged compressed data from memory buffer.
+Pages are unpacked straight from the buffer into place.
+@param bytes - buffer for decompressed pages
+@param bytesSize - size of buffer for decompressed pages
+@param src - index table followed by compressed pages
+@param srcSize - size of data available at src
+@param srcUsed - receives size of index table and pages
+@return size of decompressed data or KErrCorrupt
+@internalComponent
+@released
+*/
+int32_t DecompressPages(uint8_t* bytes, int32_t bytesSize, const uint8_t* src, int32_t srcSize, int32_t& srcUsed);
+
+/**
+This function unpacks paged compressed data from a stream page by page,
+only the index table and one page are held in memory.
+@param is - stream positioned at the index table
+@param srcSize - size of data available in the stream
+@param sink - receives the decompressed pages in order
+@param srcUsed - receives size of index table and pages
+@return size of decompressed data or KErrCorrupt
+@internalComponent
+@released
+*/
+int32_t StreamPages(std::istream& is, int32_t srcSize,
+        const std::function<void(const uint8_t*, int32_t)>& sink, int32_t& srcUsed);
+
+#endif // PAGEDCOMPRESS_H
@@ -30,6 +30,9 @@
 #include "pl_common.h"
 #include "errorhandler.h"
 #include "parametermanager.h"
+#include "workerpool.h"
+#include "dsoindex.h"
+#include "libpathindex.h"
 
 using std::endl;
 using std::cerr;
@@ -248,9 +251,28 @@ const ParameterManager::OptionDesc ParameterManager::iOptions[] =
 	{
 		"compressionmethod",
 		(void*)ParameterManager::ParseCompressionMethod,
-		"Input compression method [none|inflate|bytepair]\n\t\tnone     no compress the image.\
+		"Input compression method [none|inflate|bytepair|auto]\n\t\tnone     no compress the image.\
 		\n\t\tinflate  compress image with Inflate algorithm.\
-		\n\t\tbytepair compress image with BytePair Pak algorithm."
+		\n\t\tbytepair compress image with BytePair Pak algorithm.\
+		\n\t\tauto     compress image with both and keep the smaller."
+	},
+	{
+		"compressionmargin",
+		(void *)ParameterManager::ParseCompressionMargin,
+		"Percent by which inflate must be smaller than bytepair to be chosen by\
+		\n\t\t--compressionmethod=auto, bytepair pages load on demand. 0 by default.",
+	},
+	{
+		"jobs",
+		(void *)ParameterManager::ParseJobs,
+		"Number of threads for image compression, 0 - one per CPU (default)",
+	},
+	{
+		"compressionlevel",
+		(void *)ParameterManager::ParseCompressionLevel,
+		"Compression effort [fast|normal|max]\n\t\tfast     quicker deflate compression, larger image.\
+		\n\t\tnormal   default compression.\
+		\n\t\tmax      search for the smallest image, several times slower.",
 	},
 	{
 		"heap",
@@ -282,6 +304,16 @@ const ParameterManager::OptionDesc ParameterManager::iOptions[] =
 		(void *)ParameterManager::ParseLibPaths,
 		"A semi-colon separated search path list to locate import DSOs",
 	},
+	{
+		"dsocache",
+		(void *)ParameterManager::ParseDsoCache,
+		"Directory to keep import DSO ordinal tables in, shared between runs",
+	},
+	{
+		"libpathindex",
+		(void *)ParameterManager::ParseLibPathIndex,
+		"File to keep the listings of the library search paths in, shared between runs",
+	},
 	{
 		"sysdef",
 		(void *)ParameterManager::ParseSysDefs,
@@ -688,6 +720,79 @@ UINT ParameterManager::CompressionMethod(){
 	return iE32Header->iCompressionType;
 }
 
+/**
+This function finds out if --compressionmethod=auto option is passed to the program.
+CompressionMethod() returns bytepair in that case until the image is compressed.
+
+@internalComponent
+@released
+
+@return True if the smaller of inflate and bytepair should be chosen for every image.
+*/
+bool ParameterManager::CompressionAuto(){
+	return iCompressionAuto;
+}
+
+/**
+This function finds out the margin passed through --compressionmargin option.
+
+@internalComponent
+@released
+
+@return percent by which inflate must beat bytepair, 0 by default.
+*/
+UINT ParameterManager::CompressionMargin(){
+	return iCompressionMargin;
+}
+
+/**
+This function finds out the number of threads passed through --jobs option.
+
+@internalComponent
+@released
+
+@return number of threads or 0 if one thread per CPU should be used.
+*/
+UINT ParameterManager::Jobs(){
+	return iJobs;
+}
+
+/**
+This function finds out the directory passed through --dsocache option.
+
+@internalComponent
+@released
+
+@return cache directory or nullptr if the on-disk DSO cache is disabled.
+*/
+char * ParameterManager::DsoCache(){
+	return iDsoCache;
+}
+
+/**
+This function finds out the file passed through --libpathindex option.
+
+@internalComponent
+@released
+
+@return index file or nullptr if the library search path listings are not kept.
+*/
+char * ParameterManager::LibPathIndex(){
+	return iLibPathIndex;
+}
+
+/**
+This function finds out the compression effort passed through --compressionlevel option.
+
+@internalComponent
+@released
+
+@return compression level, ECompressionNormal by default.
+*/
+CompressionLevel ParameterManager::GetCompressionLevel(){
+	return iCompressionLevel;
+}
+
 /**
 This function finds out if the --unfrozen option is passed to the program.
 
@@ -1878,7 +1983,7 @@ Pointer to the ParameterManager
 @param aOption
 Option that is passed as input, in this case --compressionmethod
 @param aValue
-The value passed to --compressionmethod option, in this case none|inflate|bytepair
+The value passed to --compressionmethod option, in this case none|inflate|bytepair|auto
 @param aDesc
 Pointer to function ParameterManager::ParseCompressionMethod returning void.
 */
@@ -1889,7 +1994,9 @@ DEFINE_PARAM_PARSER(ParameterManager::ParseCompressionMethod)
 	if(!aValue)
 		throw Elf2e32Error(NOARGUMENTERROR, "--compressionmethod");
 
-	if(ParseCompressionMethodArg(method, aValue) )
+	if(!stricmp(aValue, "auto"))
+		aPM->SetCompressionAuto();
+	else if(ParseCompressionMethodArg(method, aValue) )
 		aPM->SetCompressionMethod(method);
 	else
 		throw Elf2e32Error(INVALIDARGUMENTERROR, aValue, "compression method");
@@ -1903,6 +2010,100 @@ from the list of existing method values.
 @released
 */
 
+/**
+This function set the number of compression threads if --jobs option is passed to the program.
+
+void ParameterManager::ParseJobs(ParameterManager * aPM, char * aOption, char * aValue, void * aDesc)
+
+@internalComponent
+@released
+
+@param aPM
+Pointer to the ParameterManager
+@param aOption
+Option that is passed as input, in this case --jobs
+@param aValue
+The number of threads passed to --jobs option
+@param aDesc
+Pointer to function ParameterManager::ParseJobs returning void.
+*/
+DEFINE_PARAM_PARSER(ParameterManager::ParseJobs)
+{
+	INITIALISE_PARAM_PARSER;
+	UINT jobs = ValidateInputVal(aValue, "--jobs");
+	aPM->SetJobs(jobs);
+}
+
+
+/**
+This function set the margin for automatic compression choice if --compressionmargin option is passed to the program.
+
+void ParameterManager::ParseCompressionMargin(ParameterManager * aPM, char * aOption, char * aValue, void * aDesc)
+
+@internalComponent
+@released
+
+@param aPM
+Pointer to the ParameterManager
+@param aOption
+Option that is passed as input, in this case --compressionmargin
+@param aValue
+The percent passed to --compressionmargin option
+@param aDesc
+Pointer to function ParameterManager::ParseCompressionMargin returning void.
+*/
+DEFINE_PARAM_PARSER(ParameterManager::ParseCompressionMargin)
+{
+	INITIALISE_PARAM_PARSER;
+	UINT margin = ValidateInputVal(aValue, "--compressionmargin");
+	if(margin > 100)
+		throw Elf2e32Error(INVALIDARGUMENTERROR, aValue, "--compressionmargin");
+	aPM->SetCompressionMargin(margin);
+}
+
+
+static const ParameterManager::CompressionLevelDesc LevelNames[] =
+{
+	{ "fast", ECompressionFast},
+	{ "normal", ECompressionNormal},
+	{ "max", ECompressionMax},
+	{ nullptr, ECompressionNormal}
+};
+
+/**
+This function set the compression level if --compressionlevel option is passed to the program.
+
+void ParameterManager::ParseCompressionLevel(ParameterManager * aPM, char * aOption, char * aValue, void * aDesc)
+
+@internalComponent
+@released
+
+@param aPM
+Pointer to the ParameterManager
+@param aOption
+Option that is passed as input, in this case --compressionlevel
+@param aValue
+The value passed to --compressionlevel option, in this case fast|normal|max
+@param aDesc
+Pointer to function ParameterManager::ParseCompressionLevel returning void.
+*/
+DEFINE_PARAM_PARSER(ParameterManager::ParseCompressionLevel)
+{
+	INITIALISE_PARAM_PARSER;
+	if(!aValue)
+		throw Elf2e32Error(NOARGUMENTERROR, "--compressionlevel");
+
+	for(int i = 0; LevelNames[i].iLevelName; i++)
+	{
+		if(!stricmp(aValue, LevelNames[i].iLevelName))
+		{
+			aPM->SetCompressionLevel(LevelNames[i].iLevel);
+			return;
+		}
+	}
+	throw Elf2e32Error(INVALIDARGUMENTERROR, aValue, "compression level");
+}
+
 
 /**
 This function set the AllowDllData flag if --dlldata option is passed to the program.
@@ -2758,6 +2959,56 @@ DEFINE_PARAM_PARSER(ParameterManager::ParseLibPaths)
     }
 }
 
+/**
+This function set the DSO cache directory that is passed through --dsocache option.
+
+void ParameterManager::ParseDsoCache(ParameterManager * aPM, char * aOption, char * aValue, void * aDesc)
+
+@internalComponent
+@released
+
+@param aPM
+Pointer to the ParameterManager
+@param aOption
+Option that is passed as input, in this case --dsocache
+@param aValue
+The directory passed to --dsocache option.
+@param aDesc
+Pointer to function ParameterManager::ParseDsoCache returning void.
+*/
+DEFINE_PARAM_PARSER(ParameterManager::ParseDsoCache)
+{
+	INITIALISE_PARAM_PARSER;
+	if (!aValue)
+		throw Elf2e32Error(NOARGUMENTERROR, "--dsocache");
+	aPM->SetDsoCache(aValue);
+}
+
+/**
+This function set the library search path index file that is passed through --libpathindex option.
+
+void ParameterManager::ParseLibPathIndex(ParameterManager * aPM, char * aOption, char * aValue, void * aDesc)
+
+@internalComponent
+@released
+
+@param aPM
+Pointer to the ParameterManager
+@param aOption
+Option that is passed as input, in this case --libpathindex
+@param aValue
+The file passed to --libpathindex option.
+@param aDesc
+Pointer to function ParameterManager::ParseLibPathIndex returning void.
+*/
+DEFINE_PARAM_PARSER(ParameterManager::ParseLibPathIndex)
+{
+	INITIALISE_PARAM_PARSER;
+	if (!aValue)
+		throw Elf2e32Error(NOARGUMENTERROR, "--libpathindex");
+	aPM->SetLibPathIndex(aValue);
+}
+
 /**
 This function sets the linkas dll name when --linkas option is passed in.
 
@@ -2950,6 +3201,87 @@ This function sets iCompressionMethod.
 */
 void ParameterManager::SetCompressionMethod(UINT aCompressionMethod){
 	iE32Header->iCompressionType = aCompressionMethod;
+	iCompressionAuto = false;
+}
+
+/**
+This function sets automatic choice of compression method for '--compressionmethod=auto'.
+Bytepair stays in the header until the image is compressed.
+
+@internalComponent
+@released
+*/
+void ParameterManager::SetCompressionAuto(){
+	iE32Header->iCompressionType = KUidCompressionBytePair;
+	iCompressionAuto = true;
+}
+
+/**
+This function sets the margin passed to '--compressionmargin' option.
+
+@internalComponent
+@released
+
+@param aMargin
+Percent by which inflate must be smaller than bytepair.
+*/
+void ParameterManager::SetCompressionMargin(UINT aMargin){
+	iCompressionMargin = aMargin;
+}
+
+/**
+This function sets the number of threads passed to '--jobs' option.
+
+@internalComponent
+@released
+
+@param aJobs
+Number of threads for compression, 0 for one per CPU.
+*/
+void ParameterManager::SetJobs(UINT aJobs){
+	iJobs = aJobs;
+	WorkerPool::SetWorkers(aJobs);
+}
+
+/**
+This function sets the directory passed to '--dsocache' option.
+
+@internalComponent
+@released
+
+@param aDir
+Directory for the on-disk cache of DSO ordinal tables.
+*/
+void ParameterManager::SetDsoCache(char * aDir){
+	iDsoCache = aDir;
+	DsoIndex::SetCacheDir(aDir);
+}
+
+/**
+This function sets the file passed to '--libpathindex' option.
+
+@internalComponent
+@released
+
+@param aFile
+File for the listings of the library search paths.
+*/
+void ParameterManager::SetLibPathIndex(char * aFile){
+	iLibPathIndex = aFile;
+	LibPathIndex::GetInstance()->SetIndexFile(aFile);
+}
+
+/**
+This function sets the compression effort passed to '--compressionlevel' option.
+
+@internalComponent
+@released
+
+@param aLevel
+Compression level.
+*/
+void ParameterManager::SetCompressionLevel(CompressionLevel aLevel){
+	iCompressionLevel = aLevel;
 }
 
 
@@ -25,19 +25,20 @@
 #include <vector>
 #include <map>
 #include <string>
+#include "pagedcompress.h"
+
+struct Arguments
+{
+    char *defInFile = nullptr;
+    char *defOutFile = nullptr;
+    char *E32InFile = nullptr;
+    char *E32OutFile = nullptr; // --output
+    char *dsoOutFile = nullptr;
+    char *elfFile = nullptr; // --elfinput
+    const char *fileDumpOpt = nullptr; // --dump
+    char *linkAsOpt = nullptr;
+};
 
-struct Arguments
-{
-    char *defInFile = nullptr;
-    char *defOutFile = nullptr;
-    char *E32InFile = nullptr;
-    char *E32OutFile = nullptr; // --output
-    char *dsoOutFile = nullptr;
-    char *elfFile = nullptr; // --elfinput
-    const char *fileDumpOpt = nullptr; // --dump
-    char *linkAsOpt = nullptr;
-};
-
 enum ETargetType
 {
 	ETargetTypeNotSet = - 2,
@@ -51,20 +52,20 @@ enum ETargetType
 	EExexp,
 	EStdExe
 };
-
-typedef uint32_t UINT;
+
+typedef uint32_t UINT;
 
 class ParameterManager
-{
-private:
-    ParameterManager(){}
-    ParameterManager(const ParameterManager& other) = delete;
+{
+private:
+    ParameterManager(){}
+    ParameterManager(const ParameterManager& other) = delete;
     ParameterManager& operator=(const ParameterManager&) = delete;
 
-public:
-    static ParameterManager *GetInstance(int argc, char** argv, E32ImageHeader* aHdr);
+public:
+    static ParameterManager *GetInstance(int argc, char** argv, E32ImageHeader* aHdr);
     static ParameterManager *Static();
-	virtual ~ParameterManager();
+	virtual ~ParameterManager();
 
 	void CheckOptions();
 
@@ -87,6 +88,12 @@ public:
 		UINT		iMethodUid;
 	};
 
+	struct CompressionLevelDesc
+	{
+		const char *iLevelName;
+		CompressionLevel iLevel;
+	};
+
 	struct SysDefs
 	{
 		int iSysDefOrdinalNum;
@@ -138,11 +145,16 @@ public:
 	DECLARE_PARAM_PARSER(ParseFixedAddress);
 	DECLARE_PARAM_PARSER(ParseUncompressed);
 	DECLARE_PARAM_PARSER(ParseCompressionMethod);
+	DECLARE_PARAM_PARSER(ParseJobs);
+	DECLARE_PARAM_PARSER(ParseCompressionLevel);
+	DECLARE_PARAM_PARSER(ParseCompressionMargin);
 	DECLARE_PARAM_PARSER(ParseHeap);
 	DECLARE_PARAM_PARSER(ParseStackCommitted);
 	DECLARE_PARAM_PARSER(ParseUnfrozen);
 	DECLARE_PARAM_PARSER(ParseIgnoreNonCallable);
 	DECLARE_PARAM_PARSER(ParseLibPaths);
+	DECLARE_PARAM_PARSER(ParseDsoCache);
+	DECLARE_PARAM_PARSER(ParseLibPathIndex);
 	DECLARE_PARAM_PARSER(ParseSysDefs);
 	DECLARE_PARAM_PARSER(ParseAllowDllData);
 	DECLARE_PARAM_PARSER(ParsePriority);
@@ -161,15 +173,15 @@ public:
 	DECLARE_PARAM_PARSER(ParseIsCustomDllTarget);
 	DECLARE_PARAM_PARSER(ParseSymNamedLookup);
 	DECLARE_PARAM_PARSER(ParseDebuggable);
-	DECLARE_PARAM_PARSER(ParseSmpSafe);
-
-	/**
-    This function parses the command line options and sets the appropriate values based on the
-    input options.
-    @internalComponent
-    @released
+	DECLARE_PARAM_PARSER(ParseSmpSafe);
+
+	/**
+    This function parses the command line options and sets the appropriate values based on the
+    input options.
+    @internalComponent
+    @released
     */
-	void ParameterAnalyser();
+	void ParameterAnalyser();
 
 	void SetTargetTypeName(ETargetType  aSetTargetTypeName);
 	void SetLinkDLLName(char * aSetLinkDLLName);
@@ -178,6 +190,12 @@ public:
 	void SetUID3(UINT aSetUINT3);
 
 	void SetCompressionMethod(UINT aCompressionMethod);
+	void SetCompressionAuto();
+	void SetCompressionMargin(UINT aMargin);
+	void SetJobs(UINT aJobs);
+	void SetDsoCache(char * aDir);
+	void SetLibPathIndex(char * aFile);
+	void SetCompressionLevel(CompressionLevel aLevel);
 	void SetSecureId(UINT aSetSecureID);
 	void SetVendorId(UINT aSetVendorID);
 	void SetHeapReservedSize(UINT aSetHeapReservedSize);
@@ -213,50 +231,50 @@ public:
 	int NumShortOptions();
 	void InitParamParser();
 	void ParseCommandLine();
-	char * Path(char * aArg);
-
-	/**
-    This function extracts the target type that is passed as input through the --targettype option.
-    @internalComponent
-    @released
-    @return the name of the input target type if provided as input through --targettype or 0.
+	char * Path(char * aArg);
+
+	/**
+    This function extracts the target type that is passed as input through the --targettype option.
+    @internalComponent
+    @released
+    @return the name of the input target type if provided as input through --targettype or 0.
     */
-	ETargetType TargetTypeName();
-
-	ETargetType ValidateTargetType(const char * aTargetType);
-
-	/**
-    This function extracts the path (where the intermediate libraries should be put)
-    that is passed as input through the --libpath option.
-    @internalComponent
-    @released
-    @return the path if provided as input through --libpath or 0.
+	ETargetType TargetTypeName();
+
+	ETargetType ValidateTargetType(const char * aTargetType);
+
+	/**
+    This function extracts the path (where the intermediate libraries should be put)
+    that is passed as input through the --libpath option.
+    @internalComponent
+    @released
+    @return the path if provided as input through --libpath or 0.
     */
-	LibSearchPaths& LibPath();
-
-	/**
-    This function extracts the DEF file name that is passed as input through the --definput option.
-    @internalComponent
-    @released
-    @return the name of the input DEF file if provided as input through --definput or 0.
+	LibSearchPaths& LibPath();
+
+	/**
+    This function extracts the DEF file name that is passed as input through the --definput option.
+    @internalComponent
+    @released
+    @return the name of the input DEF file if provided as input through --definput or 0.
     */
-	char * DefInput();
-
-	/**
-    This function return the Elf file name that is passed as input through the --elfinput option.
-    @internalComponent
-    @released
-    @return the name of the input Elf file if provided as input through --elfinput or 0.
+	char * DefInput();
+
+	/**
+    This function return the Elf file name that is passed as input through the --elfinput option.
+    @internalComponent
+    @released
+    @return the name of the input Elf file if provided as input through --elfinput or 0.
     */
-	const std::string& ElfInput();
-
-    /**
-    This function extracts the E32 image name that is passed as input through the --e32dump option.
-    @internalComponent
-    @released
-    @return the name of the input E32 image if provided as input through --e32dump or 0.
+	const std::string& ElfInput();
+
+    /**
+    This function extracts the E32 image name that is passed as input through the --e32dump option.
+    @internalComponent
+    @released
+    @return the name of the input E32 image if provided as input through --e32dump or 0.
     */
-	char * E32Input();
+	char * E32Input();
 
 	bool SysDefOption();
 	bool LogFileOption();
@@ -265,55 +283,55 @@ public:
 	TProcessPriority Priority();
 	bool PriorityOption();
 	bool CallEntryPoint();
-
-	/**
-    This function extracts the output DEF file name that is passed as input through the --defoutput option.
-    @internalComponent
-    @released
-    @return the name of the output DEF file if provided as input through --defoutput or 0.
+
+	/**
+    This function extracts the output DEF file name that is passed as input through the --defoutput option.
+    @internalComponent
+    @released
+    @return the name of the output DEF file if provided as input through --defoutput or 0.
     */
-	char * DefOutput();
-
-	/**
-    This function extracts the DSO file name that is passed as input through the --dso option.
-    @internalComponent
-    @released
-    @return the name of the output DSO file if provided as input through --dso or 0.
+	char * DefOutput();
+
+	/**
+    This function extracts the DSO file name that is passed as input through the --dso option.
+    @internalComponent
+    @released
+    @return the name of the output DSO file if provided as input through --dso or 0.
     */
-	char * DSOOutput();
-
-	/**
-    This function extracts the E32 image output that is passed as input through the --output option.
-    @internalComponent
-    @released
-    @return the name of the output E32 image output if provided as input through --output or 0.
+	char * DSOOutput();
+
+	/**
+    This function extracts the E32 image output that is passed as input through the --output option.
+    @internalComponent
+    @released
+    @return the name of the output E32 image output if provided as input through --output or 0.
     */
-	char * E32ImageOutput();
-
-    /**
-    This function extracts the name of the DLL (that the DSO is to be linked with)
-    that is passed as input through the --linkas option.
-    @internalComponent
-    @released
-    @return the name of the DLL name to be linked with if provided as input through --linkas or 0.
+	char * E32ImageOutput();
+
+    /**
+    This function extracts the name of the DLL (that the DSO is to be linked with)
+    that is passed as input through the --linkas option.
+    @internalComponent
+    @released
+    @return the name of the DLL name to be linked with if provided as input through --linkas or 0.
     */
-	char * LinkAsDLLName();
-
-	/**
-    This function extracts the filename from the absolute path that is given as input.
-    @internalComponent
-    @released
-    @param aFileName
-    The filename alongwith the absolute path.
-    @return the filename (without the absolute path) for valid input else the filename itself.
+	char * LinkAsDLLName();
+
+	/**
+    This function extracts the filename from the absolute path that is given as input.
+    @internalComponent
+    @released
+    @param aFileName
+    The filename alongwith the absolute path.
+    @return the filename (without the absolute path) for valid input else the filename itself.
     */
-	char * FileName(char * aArg);
+	char * FileName(char * aArg);
 
 	char * LogFile();
 	char * MessageFile();
 	char * DumpMessageFile();
 	const char * FileDumpOptions();
-
+
 	int SysDefCount();
 	Sys SysDefSymbols(int count);
 
@@ -321,6 +339,12 @@ public:
 	bool FixedAddress();
 
 	UINT CompressionMethod();
+	bool CompressionAuto();
+	UINT CompressionMargin();
+	UINT Jobs();
+	char * DsoCache();
+	char * LibPathIndex();
+	CompressionLevel GetCompressionLevel();
 	uint32_t HeapCommittedSize();
 	uint32_t HeapReservedSize();
 	uint32_t StackCommittedSize();
@@ -343,15 +367,15 @@ public:
 	bool IsCustomDllTarget();
 	bool SymNamedLookup();
 	bool IsDebuggable();
-	bool IsSmpSafe();
-
-	E32ImageHeader *GetE32Header();
+	bool IsSmpSafe();
+
+	E32ImageHeader *GetE32Header();
 	SSecurityInfo *GetSSecurityInfo();
 
-private:
-    E32ImageHeader *iE32Header = nullptr;
-    Arguments iOptionArgs;
-    SSecurityInfo iSecInfo;
+private:
+    E32ImageHeader *iE32Header = nullptr;
+    Arguments iOptionArgs;
+    SSecurityInfo iSecInfo;
 
 	/** The number of command line arguments passed into the program */
 	int iArgc;
@@ -423,6 +447,12 @@ private:
 	bool iSymNamedLookup = false;
 	bool iDebuggable = false;
 	bool iSmpSafe = false;
+	UINT iJobs = 0;
+	char * iDsoCache = nullptr;
+	char * iLibPathIndex = nullptr;
+	CompressionLevel iCompressionLevel = ECompressionNormal;
+	bool iCompressionAuto = false;
+	UINT iCompressionMargin = 0;
 	bool iSSTDDll = false;
 };
 
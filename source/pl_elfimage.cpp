@@ -28,11 +28,11 @@
 #include "pl_elfimage.h"
 #include "errorhandler.h"
 #include "pl_elflocalrelocation.h"
-
-using std::list;
+
+using std::list;
 using std::cout;
-
-bool ValidRelocEntry(PLUCHAR aType);
+
+bool ValidRelocEntry(PLUCHAR aType);
 
 /**
 Constructor for class ElfImage
@@ -40,8 +40,8 @@ Constructor for class ElfImage
 @released
 */
 ElfImage::ElfImage(const string& aElfInput)
-{
-    iElfInput = aElfInput;
+{
+    iElfInput = aElfInput;
 }
 
 
@@ -65,7 +65,7 @@ ElfImage::~ElfImage()
 
 	iNeeded.clear();
 //	iSymbolTable.clear();
-	DELETE_PTR_ARRAY(iMemBlock);
+	Release();
 }
 
 
@@ -108,9 +108,9 @@ void ElfImage::ProcessElfFile(Elf32_Ehdr *aElfHdr) {
 	if( iProgHeader ) {
 		PLUINT32 aIdx = 0;
 
-		while( aIdx < iElfHeader->e_phnum)
+		while( aIdx < iElfHeader->e_phnum)
         {
-			switch( iProgHeader[aIdx].p_type )
+			switch( iProgHeader[aIdx].p_type )
 			{
 			case PT_DYNAMIC:
                 iDynSegmentHdr = &iProgHeader[aIdx];
@@ -272,7 +272,7 @@ void ElfImage::ProcessVeneers()
 				 */
 				if (aInstruction == 0xE51FF004 && !aRelocEntryFound && aIsThumbSymbol)
 				{
-					ElfLocalRelocation *aRel = new ElfLocalRelocation(this, aOffset, 0, 0, R_ARM_NONE, nullptr,
+					ElfLocalRelocation *aRel = new ElfLocalRelocation(this, aOffset, 0, 0, R_ARM_NONE, nullptr,
                                     ESegmentRO, aSym, false, true);
                     AddToLocalRelocations(aRel);
 				}
@@ -319,9 +319,7 @@ PLUINT32  ElfImage::ProcessSymbols(){
 
 			aSymName = ELF_ENTRY_PTR(char, iStringTable, iElfDynSym[aSymIdx].st_name );
 			aDllName = iVerInfo[iVersionTbl[aSymIdx]].iLinkAs;
-			char *aNewSymName = new char[strlen(aSymName)+1];
-			strcpy(aNewSymName, aSymName);
-			Symbol *aSymbol = new Symbol( aNewSymName, type, &iElfDynSym[aSymIdx], aSymIdx);
+			Symbol *aSymbol = new Symbol( aSymName, type, &iElfDynSym[aSymIdx], aSymIdx);
 			aSymbol->SetSymbolSize(iElfDynSym[aSymIdx].st_size);
 
 			//Putting the symbols into a hash table - Used later while processing relocations
@@ -652,10 +650,10 @@ void ElfImage::ProcessVerInfo() {
 			break;
 		}
 		aNeed = ELF_ENTRY_PTR(Elf32_Verneed, aNeed, aNeed->vn_next);
-	}
-	for(int i = 0; i < aSz; i++)
-    {
-        auto x = iVerInfo[i];
+	}
+	for(int i = 0; i < aSz; i++)
+    {
+        auto x = iVerInfo[i];
     }
 }
 
@@ -669,6 +667,7 @@ void ElfImage::ProcessRelocations(){
 	ProcessRelocations(iRela, iRelaSize);
 	ProcessRelocations(iPltRel, iPltRelSz);
 	ProcessRelocations(iPltRela, iPltRelaSz);
+	iImports.Group();
 }
 
 /**
@@ -693,19 +692,19 @@ void ElfImage::ProcessRelocations(T *aElfRel, size_t aSize){
 
 			PLUINT32 aSymIdx = ELF32_R_SYM(aElfRel->r_info);
 			bool aImported = ImportedSymbol( &iElfDynSym[aSymIdx] );
-			Elf32_Word aAddend = Addend(aElfRel);
+			Elf32_Word aAddend = Addend(aElfRel);
 			Elf32_Rel tmp;
-			tmp.r_offset = aElfRel->r_offset;
+			tmp.r_offset = aElfRel->r_offset;
 			tmp.r_info = aElfRel->r_info;
 			ElfRelocation *aRel = nullptr;
 			if(aImported)
 			{
 				aRel = new ElfRelocation(this, tmp.r_offset, aAddend,
 						aSymIdx, aType, &tmp);
-				AddToImports(aRel);
-			}
-			else
-            {
+				AddToImports(aRel);
+			}
+			else
+            {
                 aRel = new ElfLocalRelocation(this, aElfRel->r_offset, aAddend,
 						aSymIdx, aType, &tmp);
                 AddToLocalRelocations((ElfLocalRelocation*)aRel);
@@ -786,7 +785,7 @@ This function returns the segment type
 @return Segment type
 @internalComponent
 @released
-*/
+*/
 
 ESegmentType ElfImage::SegmentType(Elf32_Addr aAddr) {
 
@@ -839,20 +838,20 @@ Elf32_Phdr* ElfImage::GetSegmentAtAddr(Elf32_Addr aAddr) {
 		if( aBase <= aAddr && aAddr < (aBase + iCodeSegmentHdr->p_memsz) ) {
 			return iCodeSegmentHdr;
 		}
-	}
+	}
 	if(iDataSegmentHdr) {
 		PLUINT32 aBase = iDataSegmentHdr->p_vaddr;
 		if( aBase <= aAddr && aAddr < (aBase + iDataSegmentHdr->p_memsz) ) {
 			return iDataSegmentHdr;
 		}
-	}
+	}
 
 	// When called from ESegmentType ElfImage::SegmentType(Elf32_Addr aAddr)
 	// for libcrypto.dll test we have have unintialized iCodeSegmentHdr and
 	// iDataSegmentHdr in some cases.
 	// This occurs if aAddr==0 and globalcntr have values 829, 1218 or
-	// aAddr==4220920 globalcntr have values 2033, 2062, 2587 and 2994
-
+	// aAddr==4220920 globalcntr have values 2033, 2062, 2587 and 2994
+
     return nullptr;
 }
 
@@ -1127,9 +1126,9 @@ Function to get RO segment size
 @released
 */
 uint32_t ElfImage::GetROSize()
-{
+{
     if(iCodeSegmentHdr)
-        return iCodeSegmentHdr->p_filesz;
+        return iCodeSegmentHdr->p_filesz;
     return 0;
 }
 
@@ -1296,7 +1295,7 @@ Function to get imports
 @internalComponent
 @released
 */
-ElfImports::ImportLibs ElfImage::GetImports() {
+const ElfImports::ImportLibs& ElfImage::GetImports() {
 	return iImports.GetImports();
 }
 
@@ -1335,9 +1334,9 @@ Function to get the segment type
 @released
 */
 ESegmentType ElfImage::Segment(Elf32_Sym *aSym)
-{
-    ESegmentType type = ESegmentUndefined;
-    if(!aSym) return type;
+{
+    ESegmentType type = ESegmentUndefined;
+    if(!aSym) return type;
 
 	Elf32_Phdr * aHdr = GetSegmentAtAddr(aSym->st_value);
 
@@ -1346,15 +1345,15 @@ ESegmentType ElfImage::Segment(Elf32_Sym *aSym)
 
 	return type;
 }
-
-void ElfImage::ElfInfo()
+
+void ElfImage::ElfInfo()
 {
 	cout << "**************************" << "\n";
-	cout << "File " << iElfInput << "\n";
-    cout << "GetROBase(): " << GetROBase() << "\ttext: " << GetROSize() << "\n";
-    cout << "GetRWBase(): " << GetRWBase() << "\tdata: " << GetRWSize() << "\n";
+	cout << "File " << iElfInput << "\n";
+    cout << "GetROBase(): " << GetROBase() << "\ttext: " << GetROSize() << "\n";
+    cout << "GetRWBase(): " << GetRWBase() << "\tdata: " << GetRWSize() << "\n";
     cout << "bss: " << GetBssSize() << "\n";
-
+
     cout << "\ntext relocs count: " << iElfRelocations.GetRelocations(ESegmentRO).size() << "\n";
     cout << "text relocs begin at addr:";
     printf("%08x\n", iElfRelocations.GetRelocations(ESegmentRO).front()->iAddr);
@@ -1363,7 +1362,7 @@ void ElfImage::ElfInfo()
     {
     	printf("%08x .text\n", x->iAddr);
     //	cout << x->iAddr << "\n";
-    }
+    }
 
     cout << "\ndata relocs count: " << iElfRelocations.GetRelocations(ESegmentRW).size() << "\n";
     cout << "data relocs begin at addr:";
@@ -1377,8 +1376,8 @@ void ElfImage::ElfInfo()
     }
 
     cout << "**************************" << "\n";
-}
-
+}
+
 /**
 This function verifies if the relocation entry is required to be
 handled by the postlinker.
@@ -1402,5 +1401,5 @@ bool ValidRelocEntry(PLUCHAR aType) {
 	default:
 		return false;
 	}
-}
+}
 
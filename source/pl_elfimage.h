@@ -44,15 +44,15 @@ This class is for ELF object carrying the elf header, sections, segments.
 */
 class ElfImage
 {
-public:
+public:
 	explicit ElfImage(const std::string& aElfInput);
-	virtual ~ElfImage();
+	virtual ~ElfImage();
 	void ElfInfo();
 
 	void ProcessElfFile(Elf32_Ehdr *aElfHdr);
 
 	PLUINT32 ProcessSymbols();
-	ElfImports::ImportLibs GetImports();
+	const ElfImports::ImportLibs& GetImports();
 	ElfExports* GetExports();
 	bool AddToExports(char* dll, Symbol* sym);
 	void AddToImports(ElfRelocation* aReloc);
@@ -84,7 +84,11 @@ public:
 	Elf32_Sym* LookupStaticSymbol(const char * name);
 private:
     void Read();
+    void Release();
     char*  iMemBlock = nullptr;
+    size_t iMemSize = 0;
+    /** iMemBlock is a file mapping rather than a heap buffer */
+    bool   iMapped = false;
 
 public:
 	Symbols GetElfSymbols();
@@ -148,7 +152,7 @@ public:
 	PLUINT32		iCodeSegmentIdx = 0;
 	ElfImports		iImports;
 	ElfExports		*iExports = nullptr;
-	ElfRelocations  iElfRelocations;
+	ElfRelocations  iElfRelocations;
 	std::string     iElfInput;
 	PLUINT32		iPltGotBase = 0;
 	PLUINT32		iPltGotLimit = 0;
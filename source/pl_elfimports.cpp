@@ -17,8 +17,9 @@
 // @released
 //
 //
-
+
 #include <cstring>
+#include <algorithm>
 #include "pl_elfimports.h"
 #include "pl_elfrelocation.h"
 
@@ -31,35 +32,48 @@ Destructor for class ElfImports to release allocated memory
 */
 ElfImports::~ElfImports()
 {
-	if(iImports.size())
-	{
-        for(auto x: iImports)
-		{
-			RelocationList *rlistTemp = &(x.second);
-
-            for(auto y: *rlistTemp)
-			{
-				ElfRelocation *temp = y;
-				delete temp;
-				temp = nullptr;
-			}
-			rlistTemp->clear();
-		}
-	}
+	for(auto x: iRelocs)
+		delete x;
+	iRelocs.clear();
 	iImports.clear();
 }
 
 
 /**
 Function to add imports
-@param aDllName - Dll name
 @param aReloc - Elf import relocation
 @internalComponent
 @released
 */
-void ElfImports::Add(ElfRelocation *aReloc){
-    char *aDllName = aReloc->iVerRecord->iLinkAs;
-	iImports[aDllName].insert(iImports[aDllName].end(), aReloc);
+void ElfImports::Add(ElfRelocation *aReloc){
+	iRelocs.push_back(aReloc);
+}
+
+
+/**
+Function sorts the imports by DSO, keeping the relocation order within every
+DSO, and records the span of each DSO. Called once all imports are added.
+@internalComponent
+@released
+*/
+void ElfImports::Group(){
+	StringPtrLess aLess;
+	std::stable_sort(iRelocs.begin(), iRelocs.end(),
+		[&aLess](const ElfRelocation *aLhs, const ElfRelocation *aRhs) {
+			return aLess(aLhs->iVerRecord->iLinkAs, aRhs->iVerRecord->iLinkAs);
+		});
+
+	iImports.clear();
+	ElfRelocation * const *aRelocs = iRelocs.data();
+	for(size_t aStart = 0, aEnd; aStart < iRelocs.size(); aStart = aEnd)
+	{
+		const char *aDllName = iRelocs[aStart]->iVerRecord->iLinkAs;
+		for(aEnd = aStart + 1; aEnd < iRelocs.size() &&
+			!strcmp(iRelocs[aEnd]->iVerRecord->iLinkAs, aDllName); aEnd++)
+			;
+		ImportLib aLib = {aDllName, aRelocs + aStart, aRelocs + aEnd};
+		iImports.push_back(aLib);
+	}
 }
 
 
@@ -70,12 +84,7 @@ Function to get import size
 @released
 */
 PLUINT32 ElfImports::GetImportSize(){
-	PLUINT32	aSize = 0;
-	for(auto x: iImports){
-		RelocationList aList = x.second;
-		aSize += aList.size();
-	}
-	return aSize;
+	return iRelocs.size();
 }
 
 
@@ -92,11 +101,11 @@ bool ElfImports::StringPtrLess::operator() (const char * lhs, const char * rhs)
 
 /**
 Function to get imports
-@return imports
+@return imports grouped by DSO
 @internalComponent
 @released
 */
-ElfImports::ImportLibs& ElfImports::GetImports()
+const ElfImports::ImportLibs& ElfImports::GetImports() const
 {
 	return iImports;
 }
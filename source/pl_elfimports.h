@@ -24,7 +24,6 @@
 
 #include "pl_common.h"
 #include <vector>
-#include <map>
 
 using std::binary_function;
 
@@ -46,16 +45,35 @@ public:
 
 	typedef std::vector<ElfRelocation*> RelocationList;
 
-	typedef std::map<const char*, RelocationList, StringPtrLess> ImportLibs;
+	/**
+	The relocations importing from one DSO, a span of the flat relocation list.
+	*/
+	struct ImportLib
+	{
+		const char *iLinkAs;
+		ElfRelocation * const *iBegin;
+		ElfRelocation * const *iEnd;
+
+		ElfRelocation * const *begin() const { return iBegin; }
+		ElfRelocation * const *end() const { return iEnd; }
+		size_t size() const { return iEnd - iBegin; }
+		ElfRelocation *operator[](size_t aIdx) const { return iBegin[aIdx]; }
+	};
+
+	/** Imported DSOs sorted by link name */
+	typedef std::vector<ImportLib> ImportLibs;
 
 	ElfImports();
 	~ElfImports();
 
 	void Add(ElfRelocation *aReloc);
+	void Group();
 	PLUINT32 GetImportSize();
-	ImportLibs& GetImports();
+	const ImportLibs& GetImports() const;
 
 private:
+	/** All import relocations, after Group() sorted by DSO link name */
+	RelocationList iRelocs;
 	ImportLibs  iImports;
 
 };
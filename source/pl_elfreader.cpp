@@ -18,28 +18,130 @@
 //
 //
 
-#include <string.h>
+#include <string.h>
 #include <fstream>
 
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define ELF_MMAP_SUPPORTED 1
+#endif
+
 #include "pl_elfimage.h"
-#include "errorhandler.h"
+#include "errorhandler.h"
 
-using std::min;
-using std::list;
-using std::fstream;
+using std::min;
+using std::list;
+using std::fstream;
 
 
+/**
+Function maps the whole file into memory as a private copy-on-write view, so
+the few in-place fixups never reach the file.
+@param aName - file to map
+@param aSize - receives the file size
+@return pointer to the view or nullptr if the file can't be mapped
+@internalComponent
+@released
+*/
+static char* MapFile(const std::string& aName, size_t& aSize)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(aName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return nullptr;
+    LARGE_INTEGER size;
+    char* view = nullptr;
+    if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if(mapping)
+        {
+            view = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        aSize = (size_t)size.QuadPart;
+    }
+    CloseHandle(file);
+    return view;
+#elif defined(ELF_MMAP_SUPPORTED)
+    int fd = open(aName.c_str(), O_RDONLY);
+    if(fd < 0)
+        return nullptr;
+    struct stat st;
+    void* view = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        view = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        aSize = st.st_size;
+    }
+    close(fd);
+    return view == MAP_FAILED ? nullptr : (char*)view;
+#else
+    (void)aName;
+    (void)aSize;
+    return nullptr;
+#endif
+}
+
+/**
+Function releases the memory holding the elf file
+@internalComponent
+@released
+*/
+void ElfImage::Release()
+{
+    if(!iMemBlock)
+        return;
+    if(iMapped)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(iMemBlock);
+#elif defined(ELF_MMAP_SUPPORTED)
+        munmap(iMemBlock, iMemSize);
+#endif
+        iMemBlock = nullptr;
+    }
+    else
+    {
+        DELETE_PTR_ARRAY(iMemBlock);
+    }
+    iMapped = false;
+    iMemSize = 0;
+}
+
+/**
+Function loads the elf file. The file gets mapped into memory if the host
+supports that, otherwise it is read into a buffer.
+@internalComponent
+@released
+*/
 void ElfImage::Read(){
-
-    fstream fs(iElfInput.c_str(), fstream::binary | fstream::in);
+
+    Release();
+    iMemBlock = MapFile(iElfInput, iMemSize);
+    if(iMemBlock)
+    {
+        iMapped = true;
+        return;
+    }
+
+    fstream fs(iElfInput.c_str(), fstream::binary | fstream::in);
     if(!fs)
-		throw Elf2e32Error(FILEOPENERROR, iElfInput);
-
-    fs.seekg(0, fs.end);
-    size_t elfSize = fs.tellg();
-    fs.seekg(0, fs.beg);
-
-    iMemBlock = new char[elfSize]();
+		throw Elf2e32Error(FILEOPENERROR, iElfInput);
+
+    fs.seekg(0, fs.end);
+    size_t elfSize = fs.tellg();
+    fs.seekg(0, fs.beg);
+
+    iMemBlock = new char[elfSize]();
+    iMemSize = elfSize;
     fs.read(iMemBlock, elfSize);
     fs.close();
 }
@@ -54,11 +156,11 @@ Funtion for getting elf symbol list
 */
 Symbols ElfImage::GetElfSymbols(){
 
-	if(!iExports)
+	if(!iExports)
 		return Symbols();
 
 	//Get the exported symbols
-	vector<Symbol*> tmp = iExports->GetExports(true);
+	vector<Symbol*> tmp = iExports->GetExports(true);
 	return Symbols(tmp.begin(), tmp.end());
 
 }
@@ -69,8 +171,8 @@ Funtion for processing elf file
 @internalComponent
 @released
 */
-PLUINT32 ElfImage::ProcessElfFile()
-{
+PLUINT32 ElfImage::ProcessElfFile()
+{
     Read();
 	Elf32_Ehdr *aElfHdr = ELF_ENTRY_PTR(Elf32_Ehdr, iMemBlock, 0);
     ProcessElfFile(aElfHdr);
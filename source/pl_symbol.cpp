@@ -19,11 +19,19 @@
 //
 
 #include <cstring>
-#include "pl_symbol.h"
-
-Symbol::Symbol(std::string aName, SymbolType aCodeDataType):
-    iSymbolName(aName), iSymbolType(aCodeDataType)
-    {}
+#include "pl_symbol.h"
+#include "linkarena.h"
+
+/**
+Constructor for class Symbol
+@param aName - symbol name, copied into the arena
+@param aCodeDataType - symbol type
+@internalComponent
+@released
+*/
+Symbol::Symbol(const char* aName, SymbolType aCodeDataType):
+    iSymbolName(LinkArena::GetInstance()->Intern(aName)), iSymbolType(aCodeDataType)
+    {}
 
 /**
 This constructor sets the symbol members.
@@ -36,10 +44,10 @@ Symbol::Symbol(Symbol& aSymbol, SymbolType aCodeDataType, bool aAbsent):
 	iSymbolName = aSymbol.SymbolName();
 	iOrdinalNumber = aSymbol.OrdNum();
 }
-
+
 /**
 Constructor for class Symbol
-@param aName - symbol name
+@param aName - symbol name, must outlive the symbol like the ELF string table does
 @param aType - symbol type
 @param aElfSym - elf symbol
 @param aSymbolIndex - index in the symbol table
@@ -47,9 +55,9 @@ Constructor for class Symbol
 @released
 */
 Symbol::Symbol(char* aName, SymbolType aType, Elf32_Sym* aElfSym,
-    PLUINT32 aSymbolIndex): iElfSym(aElfSym), iSymbolIndex(aSymbolIndex),
+    PLUINT32 aSymbolIndex): iElfSym(aElfSym), iSymbolIndex(aSymbolIndex),
     iSymbolName(aName), iSymbolType(aType)
-{}
+{}
 
 /**
 This copy constructor copies the symbol members from the input symbol.
@@ -70,7 +78,7 @@ Symbol::Symbol(Symbol& aSymbol)
 
 	iSymbolName = aSymbol.SymbolName();
 
-	if(aSymbol.Comment().empty())
+	if(!*aSymbol.Comment())
 	{
 		iComment = aSymbol.Comment();
 	}
@@ -83,6 +91,21 @@ Symbol::Symbol(Symbol& aSymbol)
 
 Symbol::~Symbol() {}
 
+/**
+Symbols are allocated in the LinkArena, deleted ones are reused for new symbols.
+@internalComponent
+@released
+*/
+void* Symbol::operator new(size_t aSize)
+{
+	return LinkArena::GetInstance()->Allocate(aSize);
+}
+
+void Symbol::operator delete(void* aPtr, size_t aSize)
+{
+	LinkArena::GetInstance()->Recycle(aPtr, aSize);
+}
+
 /**
 This function sets the symbol name.
 @param aSymbolName - The symbol name
@@ -90,8 +113,8 @@ This function sets the symbol name.
 @released
 */
 void Symbol::SetSymbolName(char *aSymbolName)
-{
-	iSymbolName.assign(aSymbolName);
+{
+	iSymbolName = LinkArena::GetInstance()->Intern(aSymbolName);
 }
 
 /**
@@ -102,7 +125,7 @@ Return - It returns true if the 2 symbols are equal.
 @released
 */
 bool Symbol::operator==(const Symbol* aSym) const {
-	if(iSymbolName.compare(aSym->iSymbolName) != 0)
+	if(iSymbolName != aSym->iSymbolName && strcmp(iSymbolName, aSym->iSymbolName) != 0)
 		return false;
 	if( iSymbolType != aSym->iSymbolType )
 		return false;
@@ -116,7 +139,7 @@ This function returns the symbol name.
 @released
 */
 const char* Symbol::SymbolName() const {
-	return iSymbolName.c_str();
+	return iSymbolName;
 }
 
 /**
@@ -125,7 +148,7 @@ This function returns the aliased symbol name.
 @released
 */
 const char* Symbol::ExportName() {
-	 return iExportName.c_str();
+	 return iExportName;
 }
 
 /**
@@ -179,7 +202,7 @@ This function returns the comment against this def file.
 @internalComponent
 @released
 */
-std::string Symbol::Comment() {
+const char* Symbol::Comment() {
 	return iComment;
 }
 
@@ -219,7 +242,7 @@ This function sets the export name of the symbol.
 */
 void Symbol::ExportName(char *aExportName)
 {
-	iExportName = aExportName;
+	iExportName = LinkArena::GetInstance()->Intern(aExportName);
 }
 
 /**
@@ -228,9 +251,9 @@ This function sets the comment against the symbol.
 @internalComponent
 @released
 */
-void Symbol::Comment(const std::string &aComment)
+void Symbol::Comment(const char *aComment)
 {
-	iComment = aComment;
+	iComment = LinkArena::GetInstance()->Intern(aComment);
 }
 
 /**
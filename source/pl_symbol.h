@@ -32,22 +32,27 @@ enum SymbolStatus {Matching,Missing,New};
 /**
  * This class is shared among all that use the symbol information.
  * To be finalized by DefFile.
+ * Symbols live in the LinkArena. Names are views into the ELF string table
+ * for symbols read from the ELF file, otherwise strings interned in the arena.
  */
 class Symbol
 {
 
-public:
-
-    Symbol(std::string aName, SymbolType aCodeDataType);
+public:
+
+    Symbol(const char* aName, SymbolType aCodeDataType);
 
 	Symbol(char* aName, SymbolType aType, Elf32_Sym* aElfSym, PLUINT32 aSymbolIndex);
 
-	Symbol(Symbol& aSymbol, SymbolType aCodeDataType, bool aAbsent);
-
+	Symbol(Symbol& aSymbol, SymbolType aCodeDataType, bool aAbsent);
+
 	Symbol(Symbol& aSymbol);
 
 	~Symbol();
 
+	static void* operator new(size_t aSize);
+	static void operator delete(void* aPtr, size_t aSize);
+
 	bool operator==(const Symbol* aSym) const;
 	const char* SymbolName() const;
 	const char* ExportName();
@@ -57,19 +62,19 @@ public:
 	bool R3unused();
 	bool Absent();
 	void SetAbsent(bool aAbsent);
-	std::string Comment();
+	const char* Comment();
 	int GetSymbolStatus();
 	void SetOrdinal(PLUINT32 aOrdinalNum);
 	void SetSymbolStatus(SymbolStatus aSymbolStatus);
 	void SetSymbolName(char *aSymbolName);
 
-	void Comment(const std::string &aComment);
+	void Comment(const char *aComment);
 	void CodeDataType(SymbolType aType);
 	void R3Unused(bool aR3Unused);
 	void ExportName(char *aExportName);
 	void SetSymbolSize(PLUINT32 aSz);
-	PLUINT32 SymbolSize();
-
+	PLUINT32 SymbolSize();
+
     Elf32_Sym	*iElfSym = nullptr;
 	/**
 	 * The index of this symbol in the symbol table(required for the hash table while
@@ -77,14 +82,14 @@ public:
 	 */
 	PLUINT32		iSymbolIndex = 0;
 
-private:
+private:
 /** TODO (Administrator#1#04/20/17): Find why and where this used unitialized!!!! */
 	SymbolStatus    iSymbolStatus;// = Missing; /* TODO: should fail if not init!!! */
-	std::string		iSymbolName;
-	std::string		iExportName;
+	const char		*iSymbolName = "";
+	const char		*iExportName = "";
 	SymbolType	    iSymbolType = SymbolTypeNotDefined; //should fail if not init!!!
 	PLUINT32	    iOrdinalNumber  = -1; // default value in ctor
-	std::string		iComment;
+	const char		*iComment = "";
 	bool		    iAbsent = false;
 	bool		    iR3Unused = false;
 	PLUINT32	    iSize = 0;
@@ -0,0 +1,168 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Implementation of the Class WorkerPool for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#include "workerpool.h"
+
+/** Number of workers for the shared pool, 0 means one per hardware thread */
+static size_t DefaultWorkers = 0;
+
+/** Worker index + 1 of the job running on this thread, 0 outside of jobs */
+static thread_local size_t CurrentWorker = 0;
+
+/**
+Function returns pool shared by all compressors.
+The pool created on first use with number of workers set by SetWorkers().
+@internalComponent
+@released
+*/
+WorkerPool *WorkerPool::GetInstance()
+{
+    static WorkerPool iInstance(DefaultWorkers);
+    return &iInstance;
+}
+
+/**
+Function sets number of workers for the shared pool. Should be called
+before first call to GetInstance(), i.e. while parsing command line.
+@param aWorkers - number of workers, 0 for one per hardware thread.
+@internalComponent
+@released
+*/
+void WorkerPool::SetWorkers(size_t aWorkers)
+{
+    DefaultWorkers = aWorkers;
+}
+
+WorkerPool::WorkerPool(size_t aWorkers)
+{
+    if(!aWorkers)
+        aWorkers = std::thread::hardware_concurrency();
+    // the calling thread is worker 0
+    for(size_t i = 1; i < aWorkers; i++)
+        iThreads.emplace_back(&WorkerPool::WorkerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(iLock);
+        iShutdown = true;
+    }
+    iStart.notify_all();
+    for(auto& t: iThreads)
+        t.join();
+}
+
+size_t WorkerPool::Workers() const
+{
+    return iThreads.size() + 1;
+}
+
+/**
+Function runs aJob for every item in range [0, aCount) and returns when all items done.
+Items are processed in arbitrary order, so aJob should store results by item index.
+If any item throws then remaining items are skipped and first exception rethrown here.
+Nested calls from a running job are processed inline by the same worker.
+@param aCount - number of items
+@param aJob - work for single item
+@internalComponent
+@released
+*/
+void WorkerPool::ParallelFor(size_t aCount, const Job& aJob)
+{
+    if(CurrentWorker || iThreads.empty() || aCount < 2)
+    {
+        size_t worker = CurrentWorker ? CurrentWorker - 1 : 0;
+        for(size_t i = 0; i < aCount; i++)
+            aJob(i, worker);
+        return;
+    }
+
+    std::lock_guard<std::mutex> batch(iBatchLock);
+    {
+        std::lock_guard<std::mutex> lock(iLock);
+        iJob = &aJob;
+        iCount = aCount;
+        iNext = 0;
+        iBusy = iThreads.size();
+        iError = nullptr;
+        ++iGeneration;
+    }
+    iStart.notify_all();
+
+    RunItems(0);
+
+    std::unique_lock<std::mutex> lock(iLock);
+    iDone.wait(lock, [this]{ return iBusy == 0; });
+    iJob = nullptr;
+    if(iError)
+    {
+        std::exception_ptr error = iError;
+        iError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkerPool::WorkerLoop(size_t aWorker)
+{
+    size_t generation = 0;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(iLock);
+            iStart.wait(lock, [&]{ return iShutdown || iGeneration != generation; });
+            if(iShutdown)
+                return;
+            generation = iGeneration;
+        }
+
+        RunItems(aWorker);
+
+        std::lock_guard<std::mutex> lock(iLock);
+        if(--iBusy == 0)
+            iDone.notify_one();
+    }
+}
+
+void WorkerPool::RunItems(size_t aWorker)
+{
+    CurrentWorker = aWorker + 1;
+    while(true)
+    {
+        size_t item;
+        {
+            std::lock_guard<std::mutex> lock(iLock);
+            if(iError || iNext >= iCount)
+                break;
+            item = iNext++;
+        }
+
+        try
+        {
+            (*iJob)(item, aWorker);
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(iLock);
+            if(!iError)
+                iError = std::current_exception();
+        }
+    }
+    CurrentWorker = 0;
+}
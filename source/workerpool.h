@@ -0,0 +1,74 @@
+// Copyright (c) 2018 Strizhniou Fiodar
+// All rights reserved.
+// This component and the accompanying materials are made available
+// under the terms of "Eclipse Public License v1.0"
+// which accompanies this distribution, and is available
+// at the URL "http://www.eclipse.org/legal/epl-v10.html".
+//
+// Initial Contributors:
+// Strizhniou Fiodar - initial contribution.
+//
+// Contributors:
+//
+// Description:
+// Class WorkerPool runs independent jobs on several threads for the elf2e32 tool
+// @internalComponent
+// @released
+//
+//
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+/**
+Pool of threads that process a range of independent work items.
+The calling thread takes part in the work as worker 0, so a pool with
+one worker runs everything inline.
+@internalComponent
+@released
+*/
+class WorkerPool
+{
+    public:
+        /** Work item callback: item index and index of the worker running it */
+        typedef std::function<void(size_t aItem, size_t aWorker)> Job;
+
+        static WorkerPool *GetInstance();
+        static void SetWorkers(size_t aWorkers);
+
+        explicit WorkerPool(size_t aWorkers);
+        ~WorkerPool();
+
+        size_t Workers() const;
+        void ParallelFor(size_t aCount, const Job& aJob);
+    private:
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        void WorkerLoop(size_t aWorker);
+        void RunItems(size_t aWorker);
+    private:
+        std::vector<std::thread> iThreads;
+        std::mutex iBatchLock;
+        std::mutex iLock;
+        std::condition_variable iStart;
+        std::condition_variable iDone;
+
+        const Job *iJob = nullptr;
+        size_t iCount = 0;
+        size_t iNext = 0;
+        size_t iBusy = 0;
+        size_t iGeneration = 0;
+        bool iShutdown = false;
+        std::exception_ptr iError;
+};
+
+#endif // WORKERPOOL_H